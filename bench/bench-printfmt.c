@@ -0,0 +1,90 @@
+// Time JOS's formatter (lib/printfmt.c built for the host, with its
+// globals renamed jos_*) on a few representative formats, next to the
+// C library's snprintf for scale.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <time.h>
+
+int jos_snprintf(char *buf, int n, const char *fmt, ...);
+void jos_printfmt(void (*putch)(int, void*), void *putdat, const char *fmt, ...);
+
+static char buf[256];
+
+static void
+putch(int ch, int *cnt)
+{
+	(*cnt)++;
+}
+
+// Each case formats its format with arguments that change with i, three
+// ways: jos_snprintf, jos_printfmt into a counting putch, and snprintf.
+#define CASE(name, fmt, ...)						\
+static void jos_snprintf_##name(unsigned i)				\
+	{ jos_snprintf(buf, sizeof(buf), fmt, __VA_ARGS__); }		\
+static void jos_printfmt_##name(unsigned i)				\
+	{ int cnt = 0; jos_printfmt((void*) putch, &cnt, fmt, __VA_ARGS__); } \
+static void libc_snprintf_##name(unsigned i)				\
+	{ snprintf(buf, sizeof(buf), fmt, __VA_ARGS__); }
+
+static const char str[] = "kern/monitor.c:mon_backtrace";
+
+CASE(hex08, "%08x", i * 2654435761u)
+CASE(dec, "%d", (int) (i * 2654435761u))
+CASE(strprec, "%.*s", (int) (i % 24), str)
+CASE(llu, "%llu", (unsigned long long) i * 0x9E3779B97F4A7C15ull)
+CASE(line, " ebp %x  eip %x  args %08x %08x %08x %08x %08x\n",
+     0xf010ff18, 0xf0100068 + i, i, i + 1, 0, 0xf0100a4c, 0x640)
+
+struct Case {
+	const char *name;
+	void (*fn[3])(unsigned);
+};
+
+#define ENTRY(name, label) \
+	{ label, { jos_snprintf_##name, jos_printfmt_##name, libc_snprintf_##name } }
+
+static const struct Case cases[] = {
+	ENTRY(hex08, "%08x"),
+	ENTRY(dec, "%d"),
+	ENTRY(strprec, "%.*s"),
+	ENTRY(llu, "%llu"),
+	ENTRY(line, "backtrace line"),
+};
+
+static double
+nsper(void (*fn)(unsigned), unsigned n)
+{
+	struct timespec t0, t1;
+	unsigned i;
+
+	for (i = 0; i < n / 16; i++)	// warm up
+		fn(i);
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+	for (i = 0; i < n; i++)
+		fn(i);
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+	return ((t1.tv_sec - t0.tv_sec) * 1e9 + (t1.tv_nsec - t0.tv_nsec)) / n;
+}
+
+int
+main(int argc, char **argv)
+{
+	unsigned n = 1000000;
+	int i;
+
+	if (argc > 2 || (argc == 2 && (n = strtoul(argv[1], NULL, 0)) == 0)) {
+		fprintf(stderr, "Usage: %s [calls]\n", argv[0]);
+		return 2;
+	}
+
+	printf("%u calls each, ns/call\n", n);
+	printf("%-16s %14s %14s %14s\n", "format", "jos_snprintf",
+	       "jos_printfmt", "snprintf");
+	for (i = 0; i < sizeof(cases) / sizeof(cases[0]); i++)
+		printf("%-16s %14.1f %14.1f %14.1f\n", cases[i].name,
+		       nsper(cases[i].fn[0], n), nsper(cases[i].fn[1], n),
+		       nsper(cases[i].fn[2], n));
+	return 0;
+}
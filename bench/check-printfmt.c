@@ -0,0 +1,177 @@
+// Check JOS's formatter (lib/printfmt.c built for the host, with its
+// globals renamed jos_*) against the C library's snprintf on random
+// formats.  Only formats on which the two are meant to agree are
+// generated: JOS pads numbers with '-' for a '-' flag, puts a '-' sign
+// ahead of the padding, ignores numeric precision and the width of %c,
+// and takes the 0 in ".0" for the '0' flag, so those combinations are
+// left out.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+int jos_snprintf(char *buf, int n, const char *fmt, ...);
+
+#define MAXCONV	4
+#define MAXWORDS (2 * MAXCONV)
+
+struct Test {
+	char fmt[128];
+	// The arguments as 32-bit words: on the i386 that is how they
+	// are passed, a long long taking two.
+	uint32_t w[MAXWORDS];
+	int nw;
+};
+
+static const char *strs[] = {
+	"", "a", "hello", "kern/monitor.c", "0123456789abcdefghij",
+};
+
+static uint32_t
+rnd32(void)
+{
+	uint32_t v = (uint32_t) random() ^ ((uint32_t) random() << 16);
+
+	// favor short numbers and edge cases
+	switch (random() % 4) {
+	case 0:
+		return v % 100;
+	case 1:
+		return v >> (random() % 32);
+	default:
+		return v;
+	}
+}
+
+static void
+append(struct Test *t, const char *s)
+{
+	strncat(t->fmt, s, sizeof(t->fmt) - strlen(t->fmt) - 1);
+}
+
+// A numeric conversion: optional '0' flag and width, then a length
+static void
+numspec(char *spec, int zero, int width, const char *len, char conv)
+{
+	char w[8] = "";
+
+	if (width)
+		sprintf(w, "%d", width);
+	sprintf(spec, "%%%s%s%s%c", zero ? "0" : "", w, len, conv);
+}
+
+static void
+add_conv(struct Test *t)
+{
+	char spec[32];
+	int width = random() % 3 ? 0 : 1 + random() % 20;
+	int zero = random() % 2;
+	const char *l = random() % 2 ? "l" : "";
+	char conv;
+	uint32_t v;
+	const char *s;
+
+	switch (random() % 9) {
+	case 0:			// %d, %ld
+		v = rnd32();
+		if (width && (int32_t) v < 0)
+			v = -v & 0x7fffffff;
+		numspec(spec, zero, width, l, 'd');
+		t->w[t->nw++] = v;
+		break;
+	case 1:			// %u, %x, %o
+	case 2:
+		numspec(spec, zero, width, l, "uxo"[random() % 3]);
+		t->w[t->nw++] = rnd32();
+		break;
+	case 3:			// %lld, %llu, %llx
+		conv = "dux"[random() % 3];
+		numspec(spec, zero, width, "ll", conv);
+		t->w[t->nw++] = rnd32();
+		v = random() % 2 ? rnd32() : 0;
+		if (width && conv == 'd')
+			v &= 0x7fffffff;
+		t->w[t->nw++] = v;
+		break;
+	case 4:			// %s, maybe left-justified, with precision
+	case 5:
+		s = strs[random() % (sizeof(strs) / sizeof(strs[0]))];
+		sprintf(spec, "%%%s", random() % 2 ? "-" : "");
+		if (width)
+			sprintf(spec + strlen(spec), "%d", width);
+		if (random() % 2)
+			sprintf(spec + strlen(spec), ".%d", (int) (1 + random() % 11));
+		strcat(spec, "s");
+		t->w[t->nw++] = (uint32_t) (uintptr_t) s;
+		break;
+	case 6:
+		strcpy(spec, "%c");
+		t->w[t->nw++] = ' ' + random() % 95;
+		break;
+	case 7:
+		strcpy(spec, "%%");
+		break;
+	case 8:			// %p, non-NULL
+		strcpy(spec, "%p");
+		t->w[t->nw++] = rnd32() | 1;
+		break;
+	}
+	append(t, spec);
+}
+
+static void
+make_test(struct Test *t)
+{
+	static const char lit[] = "abc XYZ:=\t\n-0.";
+	char run[8];
+	int i, j, n;
+
+	t->fmt[0] = 0;
+	t->nw = 0;
+	n = random() % (MAXCONV + 1);
+	for (i = 0; i <= n; i++) {
+		for (j = random() % 4; j > 0; j--) {
+			run[0] = lit[random() % (sizeof(lit) - 1)];
+			run[1] = 0;
+			append(t, run);
+		}
+		if (i < n)
+			add_conv(t);
+	}
+}
+
+#define ARGS(w) w[0], w[1], w[2], w[3], w[4], w[5], w[6], w[7]
+
+int
+main(int argc, char **argv)
+{
+	struct Test t;
+	char jbuf[256], cbuf[256];
+	unsigned long i, n = 1000000;
+	int size, jr, cr, bad = 0;
+
+	if (argc > 3 || (argc >= 2 && (n = strtoul(argv[1], NULL, 0)) == 0)) {
+		fprintf(stderr, "Usage: %s [tests [seed]]\n", argv[0]);
+		return 2;
+	}
+	srandom(argc == 3 ? strtoul(argv[2], NULL, 0) : 1);
+
+	for (i = 0; i < n && bad < 10; i++) {
+		make_test(&t);
+		// sometimes a buffer too small for the output
+		size = random() % 4 ? sizeof(jbuf) : 1 + random() % 16;
+		memset(jbuf, 0x55, sizeof(jbuf));
+		memset(cbuf, 0x55, sizeof(cbuf));
+		jr = jos_snprintf(jbuf, size, t.fmt, ARGS(t.w));
+		cr = snprintf(cbuf, size, t.fmt, ARGS(t.w));
+		if (jr != cr || memcmp(jbuf, cbuf, sizeof(jbuf)) != 0) {
+			printf("MISMATCH: format \"%s\", size %d\n"
+			       "  jos:  %d \"%s\"\n  libc: %d \"%s\"\n",
+			       t.fmt, size, jr, jbuf, cr, cbuf);
+			bad++;
+		}
+	}
+	printf("%lu formats, %d mismatches\n", i, bad);
+	return bad != 0;
+}
@@ -0,0 +1,35 @@
+#ifndef JOS_BOOT_BOOT_H
+#define JOS_BOOT_BOOT_H
+
+/*
+ * Definitions shared by the boot sector (boot/boot.S, boot/main.c)
+ * and the second-stage loader (boot/loadentry.S, boot/loader.c).
+ *
+ * DISK LAYOUT
+ *  * sector 0:			the boot sector
+ *  * sectors 1..LOADER_NSECT:	the second-stage loader
+ *  * the rest:			the kernel image
+ *
+ * LOADER_NSECT and LOADER_ADDR are set in boot/Makefrag, which also
+ * lays out the disk image.
+ */
+
+#define SECTSIZE	512
+
+// Disk offset of the kernel image
+#define KERNOFF		((1 + LOADER_NSECT) * SECTSIZE)
+
+#ifndef __ASSEMBLER__
+#include <inc/types.h>
+#include <inc/bootinfo.h>
+
+// Where the boot sector and loader build the kernel's struct Bootinfo
+#define BOOTINFO	((struct Bootinfo *) BOOTINFO_PADDR)
+
+// boot/disk.c
+void	readseg(uint32_t pa, uint32_t count, uint32_t offset);
+void	readsects(void *dst, uint32_t sect, uint32_t nsect);
+void	waitdisk(void);
+#endif /* !__ASSEMBLER__ */
+
+#endif /* !JOS_BOOT_BOOT_H */
@@ -0,0 +1,79 @@
+#include <inc/x86.h>
+
+#include <boot/boot.h>
+
+/*
+ * Programmed-I/O disk reads from the first IDE disk, shared by the
+ * boot sector and the second-stage loader.
+ */
+
+// Read 'count' bytes at disk offset 'offset' into physical address 'pa'.
+// Might copy more than asked
+void
+readseg(uint32_t pa, uint32_t count, uint32_t offset)
+{
+	uint32_t end_pa, nsect;
+
+	end_pa = pa + count;
+
+	// round down to sector boundary
+	pa &= ~(SECTSIZE - 1);
+	// 这个向下舍入就是将低 9 位全部变成0, 这样才能使地址扇区对齐
+	// translate from bytes to sectors
+	offset = offset / SECTSIZE;
+	// 这一步就是将页大小变成扇区大小, 一页是 4 个扇区
+	// 因为从硬盘每次读的是一个扇区的单位
+	// Read the contiguous run with as few commands as possible:
+	// one READ SECTORS command transfers up to 256 sectors.
+	// We'd write more to memory than asked, but it doesn't matter --
+	// we load in increasing order.
+	while (pa < end_pa) {
+		// Since we haven't enabled paging yet and we're using
+		// an identity segment mapping (see boot.S), we can
+		// use physical addresses directly.  This won't be the
+		// case once JOS enables the MMU.
+		nsect = (end_pa - pa + SECTSIZE - 1) / SECTSIZE;
+		if (nsect > 256)
+			nsect = 256;
+		readsects((uint8_t*) pa, offset, nsect);
+		pa += nsect * SECTSIZE;
+		offset += nsect;
+	}
+}
+
+void
+waitdisk(void)
+{
+	// wait for disk reaady
+	while ((inb(0x1F7) & 0xC0) != 0x40)
+		/* do nothing */;
+}
+
+// Read 'nsect' (1..256) consecutive sectors starting at sector 'sect'.
+void
+readsects(void *dst, uint32_t sect, uint32_t nsect)
+{
+	// wait for disk to be ready
+	waitdisk();
+	// 把数据写入端口
+	outb(0x1F2, nsect);	// count; 256 is written as 0
+	// sect 太长了, 所以分段
+	// 注意,  0x1F 是端口, 后面是数据
+	outb(0x1F3, sect);
+	outb(0x1F4, sect >> 8);
+	outb(0x1F5, sect >> 16);
+	outb(0x1F6, (sect >> 24) | 0xE0);
+	outb(0x1F7, 0x20);	// cmd 0x20 - read sectors
+	// 注意secno是通过不同的端口，分四次发给磁盘的。
+	// 然后向0x1f7端口发出0x20，说明我要开始读扇区了。
+
+	// The drive raises DRQ (with BSY clear) once per sector
+	// while the command is in progress; drain each sector then.
+	for (; nsect > 0; nsect--) {
+		while ((inb(0x1F7) & 0x88) != 0x08)
+			/* do nothing */;
+		// 注意 insl 函数中的 repne 就是重复读, 因为 inl 每次读 4 字节, 所以要读 SECTSIZE/4 次
+		insl(0x1F0, dst, SECTSIZE/4);
+		dst += SECTSIZE;
+	}
+}
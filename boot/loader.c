@@ -0,0 +1,408 @@
+#include <inc/x86.h>
+#include <inc/elf.h>
+#include <inc/bootinfo.h>
+
+#include <boot/boot.h>
+#include <boot/zimage.h>
+
+/**********************************************************************
+ * Second-stage boot loader.  The boot sector (boot.S and main.c)
+ * loads us from the sectors following it; we load the ELF kernel
+ * image that follows us on disk and jump to it.
+ *
+ * Each kernel segment is transferred by the PCI bus-master IDE
+ * controller (the PIIX that QEMU emulates) straight to its load
+ * address, so the data never passes through the CPU.  When there is
+ * no bus-master controller, or a transfer fails, we fall back to the
+ * boot sector's PIO readseg().
+ *
+ * Only the p_filesz bytes of a segment come from disk; we zero the
+ * rest ourselves and say so in the struct Bootinfo we hand the kernel
+ * (see inc/bootinfo.h), so it need not clear its BSS a second time.
+ *
+ * The image is streamed once, front to back: segments are loaded in
+ * file order and no disk sector is read twice (see loadsegs()).
+ *
+ * The kernel image may also be an LZ4-compressed image built by
+ * boot/mkzimage (see boot/zimage.h).  Then we read all of it in one
+ * go to the memory just past the kernel and decompress each segment
+ * to its load address from there.
+ **********************************************************************/
+
+#define ELFHDR		((struct Elf *) 0x10000) // scratch space
+#define ZIMGHDR		((struct Zimghdr *) ELFHDR)
+#define HDRSECT		8	// sectors read into ELFHDR (one page)
+
+#define NPHDR		16	// most loadable segments we handle
+static struct Proghdr *phs[NPHDR];
+
+/***** PCI configuration space *****/
+
+#define PCI_CONF_ADDR	0xCF8
+#define PCI_CONF_DATA	0xCFC
+
+#define PCI_ID		0x00	// Vendor (low 16 bits), device (high)
+#define PCI_CMD		0x04	// Command (low 16 bits), status (high)
+#define   PCI_CMD_IO	0x0001	//   Enable I/O space decoding
+#define   PCI_CMD_MASTER 0x0004	//   Enable bus mastering
+#define PCI_CLASS	0x08	// Class, subclass, prog-if, revision
+#define   PCI_IDE_MASTER 0x80	//   prog-if: bus-master capable
+#define   PCI_IDE_PRINAT 0x01	//   prog-if: primary channel in native mode
+#define PCI_BAR4	0x20	// Bus-master IDE I/O base
+
+static uint32_t
+pci_conf_read(uint32_t bdf, uint32_t reg)
+{
+	outl(PCI_CONF_ADDR, 0x80000000 | bdf | reg);
+	return inl(PCI_CONF_DATA);
+}
+
+static void
+pci_conf_write(uint32_t bdf, uint32_t reg, uint32_t v)
+{
+	outl(PCI_CONF_ADDR, 0x80000000 | bdf | reg);
+	outl(PCI_CONF_DATA, v);
+}
+
+/***** Bus-master IDE DMA *****/
+
+// Primary channel bus-master registers, relative to BAR4
+#define BM_CMD		0	// Command
+#define   BM_CMD_START	0x01	//   Start transfer
+#define   BM_CMD_TOMEM	0x08	//   Transfer from the drive to memory
+#define BM_STATUS	2	// Status (bits are write-1-to-clear)
+#define   BM_STATUS_ERR	0x02	//   Transfer failed
+#define   BM_STATUS_INTR 0x04	//   Drive raised its interrupt
+#define BM_PRDT		4	// Physical address of the PRD table
+
+// Physical Region Descriptor: one contiguous chunk of a transfer.
+// A chunk may not cross a 64KB boundary.
+struct Prd {
+	uint32_t addr;
+	uint16_t count;		// Bytes; 0 means 64KB
+	uint16_t flags;
+};
+#define PRD_EOT		0x8000	// Last descriptor in the table
+
+// The table must be 4-byte aligned and must not cross a 64KB
+// boundary; the loader lives below 64KB, so that comes for free.
+#define NPRD		16
+static struct Prd prdtab[NPRD];
+
+// Largest transfer prdtab can always describe
+#define DMA_MAXSECT	((NPRD - 1) * (0x10000 / SECTSIZE))
+
+static uint16_t bmide;		// Bus-master I/O base, 0 if none
+
+// Find a bus-master IDE controller whose primary channel sits at
+// the legacy ports readsects() uses, and enable its bus mastering.
+static uint16_t
+bmide_probe(void)
+{
+	uint32_t bdf, class, bar;
+
+	// Bus 0 only: device in bits 15:11, function in bits 10:8
+	for (bdf = 0; bdf < (32 << 11); bdf += 1 << 8) {
+		if ((pci_conf_read(bdf, PCI_ID) & 0xFFFF) == 0xFFFF)
+			continue;
+		class = pci_conf_read(bdf, PCI_CLASS);
+		if ((class >> 16) != 0x0101	// mass storage, IDE
+		    || !((class >> 8) & PCI_IDE_MASTER)
+		    || ((class >> 8) & PCI_IDE_PRINAT))
+			continue;
+		bar = pci_conf_read(bdf, PCI_BAR4);
+		if (!(bar & 1) || !(bar & 0xFFFC))	// must be I/O space
+			continue;
+		pci_conf_write(bdf, PCI_CMD, (pci_conf_read(bdf, PCI_CMD) & 0xFFFF)
+			       | PCI_CMD_IO | PCI_CMD_MASTER);
+		return bar & 0xFFFC;
+	}
+	return 0;
+}
+
+// DMA 'nsect' (at most DMA_MAXSECT) sectors starting at sector 'sect'
+// to physical address 'pa', which must be sector aligned.
+// Returns 0 on success, -1 if the transfer failed.
+static int
+dma_readsects(uint32_t pa, uint32_t sect, uint32_t nsect)
+{
+	uint32_t end_pa, len;
+	uint8_t st;
+	int n;
+
+	// Describe the destination, splitting it at 64KB boundaries
+	end_pa = pa + nsect * SECTSIZE;
+	for (n = 0; pa < end_pa; n++) {
+		len = MIN(end_pa - pa, 0x10000 - (pa & 0xFFFF));
+		prdtab[n].addr = pa;
+		prdtab[n].count = len;
+		prdtab[n].flags = 0;
+		pa += len;
+	}
+	prdtab[n - 1].flags = PRD_EOT;
+
+	outb(bmide + BM_CMD, 0);
+	outl(bmide + BM_PRDT, (uint32_t) prdtab);
+	outb(bmide + BM_STATUS, BM_STATUS_ERR | BM_STATUS_INTR);
+
+	// READ DMA EXT: 48-bit LBA, 16-bit count, high bytes first
+	waitdisk();
+	outb(0x1F2, nsect >> 8);
+	outb(0x1F3, sect >> 24);
+	outb(0x1F4, 0);
+	outb(0x1F5, 0);
+	outb(0x1F2, nsect);
+	outb(0x1F3, sect);
+	outb(0x1F4, sect >> 8);
+	outb(0x1F5, sect >> 16);
+	outb(0x1F6, 0x40);	// LBA, drive 0
+	outb(0x1F7, 0x25);	// cmd 0x25 - read DMA ext
+
+	outb(bmide + BM_CMD, BM_CMD_START | BM_CMD_TOMEM);
+	while (!((st = inb(bmide + BM_STATUS)) & (BM_STATUS_ERR | BM_STATUS_INTR)))
+		/* do nothing */;
+	outb(bmide + BM_CMD, 0);
+
+	// Reading the drive status also acknowledges its interrupt
+	if ((st & BM_STATUS_ERR) || (inb(0x1F7) & 0x21))	// ERR or DF
+		return -1;
+	return 0;
+}
+
+// DMA counterpart of readseg(): read 'count' bytes at disk offset
+// 'offset' into physical address 'pa'.  Might copy more than asked.
+static int
+dma_readseg(uint32_t pa, uint32_t count, uint32_t offset)
+{
+	uint32_t end_pa, nsect;
+
+	end_pa = pa + count;
+	pa &= ~(SECTSIZE - 1);
+	offset /= SECTSIZE;
+	while (pa < end_pa) {
+		nsect = (end_pa - pa + SECTSIZE - 1) / SECTSIZE;
+		if (nsect > DMA_MAXSECT)
+			nsect = DMA_MAXSECT;
+		if (dma_readsects(pa, offset, nsect) < 0)
+			return -1;
+		pa += nsect * SECTSIZE;
+		offset += nsect;
+	}
+	return 0;
+}
+
+// Read 'count' bytes at 'offset' from the kernel into physical
+// address 'pa', by DMA if we can, otherwise by PIO.
+static void
+loadseg(uint32_t pa, uint32_t count, uint32_t offset)
+{
+	if (bmide && dma_readseg(pa, count, KERNOFF + offset) == 0)
+		return;
+	// Don't try DMA again once it has failed
+	bmide = 0;
+	readseg(pa, count, KERNOFF + offset);
+}
+
+// Copy 'count' bytes from physical address 'src' to 'dst'.
+static void
+copyseg(uint32_t dst, uint32_t src, uint32_t count)
+{
+	asm volatile("cld; rep movsb"
+		     : "+D" (dst), "+S" (src), "+c" (count) : : "cc", "memory");
+}
+
+// Load the file part of the 'n' segments in 'phs', which are sorted
+// by p_offset, reading each disk sector of the image at most once.
+// Sectors are read in increasing order straight to the segment that
+// starts in them; bytes of a sector that is already in memory -- the
+// header page, or a sector two segments share -- are copied from
+// where that sector landed.
+static void
+loadsegs(struct Proghdr **phs, int n)
+{
+	uint32_t start, end, pa, len;
+	uint32_t cs, cpa, next;
+	int i;
+
+	// Sectors [cs, next) of the image are in memory, in order, at cpa
+	cs = 0;
+	cpa = (uint32_t) ELFHDR;
+	next = HDRSECT;
+	for (i = 0; i < n; i++) {
+		start = phs[i]->p_offset;
+		end = start + phs[i]->p_filesz;
+		pa = phs[i]->p_pa;
+		if (start == end)
+			continue;
+		if (start < cs * SECTSIZE) {
+			// Overlaps an earlier segment's sectors, which may
+			// be gone by now; just read it again.
+			loadseg(pa, end - start, start);
+			continue;
+		}
+		if (start < next * SECTSIZE) {
+			len = MIN(end, next * SECTSIZE) - start;
+			copyseg(pa, cpa + start - cs * SECTSIZE, len);
+			if (end == start + len)
+				continue;
+			pa += len;
+			start += len;
+		}
+		// Sectors between the previous segment and this one are
+		// skipped, not read.
+		loadseg(pa, end - start, start);
+		cs = start / SECTSIZE;
+		cpa = pa & ~(SECTSIZE - 1);
+		next = (end + SECTSIZE - 1) / SECTSIZE;
+	}
+}
+
+// Zero 'count' bytes at physical address 'pa'.
+static void
+zeroseg(uint32_t pa, uint32_t count)
+{
+	uint32_t n;
+
+	// Bytes up to a dword boundary, then whole dwords, then the tail
+	n = MIN(-pa & 3, count);
+	count -= n;
+	asm volatile("cld; rep stosb" : "+D" (pa), "+c" (n) : "a" (0) : "cc", "memory");
+	n = count / 4;
+	asm volatile("rep stosl" : "+D" (pa), "+c" (n) : "a" (0) : "cc", "memory");
+	n = count % 4;
+	asm volatile("rep stosb" : "+D" (pa), "+c" (n) : "a" (0) : "cc", "memory");
+}
+
+// Load an ELF kernel image, whose first page is at ELFHDR.
+// Returns the entry point, or 0 if we can't load it.
+static uint32_t
+loadelf(void)
+{
+	struct Proghdr *ph, *eph;
+	int i, j, n;
+
+	// sort the loadable segments by file offset
+	ph = (struct Proghdr *) ((uint8_t *) ELFHDR + ELFHDR->e_phoff);
+	eph = ph + ELFHDR->e_phnum;
+	for (n = 0; ph < eph; ph++) {
+		if (ph->p_type != ELF_PROG_LOAD)
+			continue;
+		if (n == NPHDR)
+			return 0;
+		for (j = n++; j > 0 && phs[j - 1]->p_offset > ph->p_offset; j--)
+			phs[j] = phs[j - 1];
+		phs[j] = ph;
+	}
+
+	// p_pa is the load address of each segment (as well as the
+	// physical address).  Only p_filesz bytes are on disk; the rest
+	// of p_memsz (the BSS) is zero.  Zero it only once everything is
+	// read, since the sector a segment ends in may also hold the
+	// start of the next one.
+	loadsegs(phs, n);
+	for (i = 0; i < n; i++)
+		zeroseg(phs[i]->p_pa + phs[i]->p_filesz,
+			phs[i]->p_memsz - phs[i]->p_filesz);
+	return ELFHDR->e_entry;
+}
+
+// Decompress 'csize' bytes of LZ4 block data at 'src' to 'dst'.
+static void
+lz4_decompress(uint32_t dst, uint32_t src, uint32_t csize)
+{
+	uint32_t end, len, from;
+	uint8_t token, b;
+
+	end = src + csize;
+	while (src < end) {
+		// literal run
+		token = *(uint8_t *) src++;
+		len = token >> 4;
+		if (len == 15)
+			do {
+				b = *(uint8_t *) src++;
+				len += b;
+			} while (b == 255);
+		copyseg(dst, src, len);
+		dst += len;
+		src += len;
+		if (src >= end)		// the last sequence has no match
+			break;
+
+		// match: offset back into the output, then length;
+		// rep movsb copies forward a byte at a time, so
+		// overlapping matches come out right
+		from = dst - (*(uint8_t *) src | *(uint8_t *) (src + 1) << 8);
+		src += 2;
+		len = token & 15;
+		if (len == 15)
+			do {
+				b = *(uint8_t *) src++;
+				len += b;
+			} while (b == 255);
+		len += 4;
+		copyseg(dst, from, len);
+		dst += len;
+	}
+}
+
+// Load a compressed kernel image, whose first page is at ZIMGHDR.
+// Returns the entry point.
+static uint32_t
+loadzimage(void)
+{
+	struct Zseg *zs, *ezs;
+	uint32_t buf;
+
+	// The compressed data goes just past the end of the kernel
+	zs = (struct Zseg *) (ZIMGHDR + 1);
+	ezs = zs + ZIMGHDR->z_nseg;
+	for (buf = 0; zs < ezs; zs++)
+		buf = MAX(buf, zs->zs_pa + zs->zs_memsz);
+	buf = ROUNDUP(buf, SECTSIZE);
+	loadseg(buf, ZIMGHDR->z_size - ZIMAGE_HDRSIZE, ZIMAGE_HDRSIZE);
+
+	for (zs = (struct Zseg *) (ZIMGHDR + 1); zs < ezs; zs++) {
+		lz4_decompress(zs->zs_pa, buf + zs->zs_offset - ZIMAGE_HDRSIZE,
+			       zs->zs_csize);
+		zeroseg(zs->zs_pa + zs->zs_filesz, zs->zs_memsz - zs->zs_filesz);
+	}
+	return ZIMGHDR->z_entry;
+}
+
+void
+loadermain(void)
+{
+	uint32_t entry;
+
+	BOOTINFO->flags = 0;
+	bmide = bmide_probe();
+	BOOTINFO->tsc[BOOTTS_KERN_READ] = read_tsc();
+
+	// read 1st page off disk, 一页的大小是 4KB
+	loadseg((uint32_t) ELFHDR, HDRSECT*SECTSIZE, 0);
+
+	// is this a valid ELF, or a compressed image?
+	if (ELFHDR->e_magic == ELF_MAGIC)
+		entry = loadelf();
+	else if (ZIMGHDR->z_magic == ZIMAGE_MAGIC)
+		entry = loadzimage();
+	else
+		goto bad;
+	if (entry == 0)
+		goto bad;
+	BOOTINFO->flags |= BOOTINFO_BSSCLEAR;
+	BOOTINFO->tsc[BOOTTS_KERN_DONE] = read_tsc();
+
+	// call the entry point, handing it the boot information
+	// the way inc/bootinfo.h describes
+	// note: does not return!
+	asm volatile("jmp *%0"
+		     : : "r" (entry), "a" (BOOTINFO_MAGIC), "b" (BOOTINFO));
+
+bad:
+	outw(0x8A00, 0x8A00);
+	outw(0x8A00, 0x8E00);
+	while (1)
+		/* do nothing */;
+}
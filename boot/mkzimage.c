@@ -0,0 +1,203 @@
+/*
+ * Build a compressed kernel image (see boot/zimage.h) from the kernel
+ * ELF: the file contents of each loadable segment, LZ4 compressed.
+ * The boot loader decompresses them, trading slow disk reads for
+ * fast in-memory decompression.
+ *
+ * usage: mkzimage kernel kernel.lz4
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+
+#include <inc/elf.h>
+#include <boot/zimage.h>
+
+// LZ4 block format parameters
+#define MINMATCH	4	// Shortest match
+#define LASTLITERALS	5	// The last bytes of a block are literals
+#define MFLIMIT		12	// No match may start in the last bytes
+#define MAXOFFSET	65535	// Matches reach back at most this far
+#define HASHLOG		16
+#define MAXCHAIN	256	// Candidates tried per position
+
+static int32_t head[1 << HASHLOG];
+
+static uint32_t
+hash4(const uint8_t *p)
+{
+	uint32_t v;
+
+	memcpy(&v, p, 4);
+	return (v * 2654435761U) >> (32 - HASHLOG);
+}
+
+static uint8_t *
+putlen(uint8_t *op, size_t len)
+{
+	for (; len >= 255; len -= 255)
+		*op++ = 255;
+	*op++ = len;
+	return op;
+}
+
+// Emit one sequence: 'nlit' literals, then a match of 'mlen' bytes
+// 'off' back, or no match if mlen is 0 (the last sequence).
+static uint8_t *
+putseq(uint8_t *op, const uint8_t *lit, size_t nlit, size_t off, size_t mlen)
+{
+	uint8_t *token = op++;
+
+	*token = (nlit < 15 ? nlit : 15) << 4;
+	if (nlit >= 15)
+		op = putlen(op, nlit - 15);
+	memcpy(op, lit, nlit);
+	op += nlit;
+	if (mlen == 0)
+		return op;
+	*op++ = off;
+	*op++ = off >> 8;
+	mlen -= MINMATCH;
+	*token |= mlen < 15 ? mlen : 15;
+	if (mlen >= 15)
+		op = putlen(op, mlen - 15);
+	return op;
+}
+
+// LZ4 block-compress 'n' bytes at 'src' into 'dst', which must have
+// room for n + n/255 + 16 bytes.  Returns the compressed size.
+static size_t
+lz4_compress(const uint8_t *src, size_t n, uint8_t *dst)
+{
+	int32_t *chain, cand;
+	size_t ip, anchor, len, best, bestoff, limit, i;
+	uint8_t *op = dst;
+	int depth;
+
+	if ((chain = malloc((n + 1) * sizeof(*chain))) == NULL) {
+		perror("malloc");
+		exit(1);
+	}
+	memset(head, -1, sizeof(head));
+
+	// Matches may not extend into the last LASTLITERALS bytes
+	limit = n - LASTLITERALS;
+	for (ip = anchor = 0; n >= MFLIMIT && ip <= n - MFLIMIT; ) {
+		best = bestoff = 0;
+		cand = head[hash4(src + ip)];
+		for (depth = 0; cand >= 0 && ip - cand <= MAXOFFSET
+			     && depth < MAXCHAIN; cand = chain[cand], depth++) {
+			for (len = 0; ip + len < limit
+				     && src[cand + len] == src[ip + len]; len++)
+				/* do nothing */;
+			if (len > best)
+				best = len, bestoff = ip - cand;
+		}
+		if (best < MINMATCH) {
+			chain[ip] = head[hash4(src + ip)];
+			head[hash4(src + ip)] = ip;
+			ip++;
+			continue;
+		}
+		op = putseq(op, src + anchor, ip - anchor, bestoff, best);
+		for (i = ip; i < ip + best && i <= n - MFLIMIT; i++) {
+			chain[i] = head[hash4(src + i)];
+			head[hash4(src + i)] = i;
+		}
+		anchor = ip += best;
+	}
+	op = putseq(op, src + anchor, n - anchor, 0, 0);
+
+	free(chain);
+	return op - dst;
+}
+
+static void
+writeat(FILE *f, long off, const void *buf, size_t n, const char *name)
+{
+	if (fseek(f, off, SEEK_SET) < 0 || fwrite(buf, 1, n, f) != n) {
+		fprintf(stderr, "write %s: %s\n", name, strerror(errno));
+		exit(1);
+	}
+}
+
+int
+main(int argc, char **argv)
+{
+	FILE *f;
+	uint8_t *elf, *cbuf;
+	long size;
+	struct Elf *eh;
+	struct Proghdr *ph;
+	struct Zimghdr zh;
+	struct Zseg zs;
+	uint32_t off, total;
+	int i;
+
+	if (argc != 3) {
+		fprintf(stderr, "usage: mkzimage kernel kernel.lz4\n");
+		exit(2);
+	}
+
+	if ((f = fopen(argv[1], "rb")) == NULL
+	    || fseek(f, 0, SEEK_END) < 0 || (size = ftell(f)) < 0
+	    || (elf = malloc(size)) == NULL
+	    || fseek(f, 0, SEEK_SET) < 0 || fread(elf, 1, size, f) != size) {
+		fprintf(stderr, "read %s: %s\n", argv[1], strerror(errno));
+		exit(1);
+	}
+	fclose(f);
+
+	eh = (struct Elf *) elf;
+	if (size < sizeof(*eh) || eh->e_magic != ELF_MAGIC
+	    || eh->e_phoff + eh->e_phnum * sizeof(*ph) > size) {
+		fprintf(stderr, "%s: not an ELF file\n", argv[1]);
+		exit(1);
+	}
+
+	if ((f = fopen(argv[2], "wb")) == NULL) {
+		fprintf(stderr, "open %s: %s\n", argv[2], strerror(errno));
+		exit(1);
+	}
+
+	memset(&zh, 0, sizeof(zh));
+	zh.z_magic = ZIMAGE_MAGIC;
+	zh.z_entry = eh->e_entry;
+	off = ZIMAGE_HDRSIZE;
+	total = 0;
+	ph = (struct Proghdr *) (elf + eh->e_phoff);
+	for (i = 0; i < eh->e_phnum; i++, ph++) {
+		if (ph->p_type != ELF_PROG_LOAD)
+			continue;
+		if (ph->p_offset + ph->p_filesz > size
+		    || sizeof(zh) + (zh.z_nseg + 1) * sizeof(zs) > ZIMAGE_HDRSIZE) {
+			fprintf(stderr, "%s: bad program header %d\n", argv[1], i);
+			exit(1);
+		}
+		cbuf = malloc(ph->p_filesz + ph->p_filesz / 255 + 16);
+		zs.zs_offset = off;
+		zs.zs_csize = lz4_compress(elf + ph->p_offset, ph->p_filesz, cbuf);
+		zs.zs_pa = ph->p_pa;
+		zs.zs_filesz = ph->p_filesz;
+		zs.zs_memsz = ph->p_memsz;
+		writeat(f, off, cbuf, zs.zs_csize, argv[2]);
+		writeat(f, sizeof(zh) + zh.z_nseg * sizeof(zs), &zs, sizeof(zs), argv[2]);
+		free(cbuf);
+		off += zs.zs_csize;
+		total += zs.zs_filesz;
+		zh.z_nseg++;
+	}
+	zh.z_size = off;
+	writeat(f, 0, &zh, sizeof(zh), argv[2]);
+	if (fclose(f) != 0) {
+		fprintf(stderr, "write %s: %s\n", argv[2], strerror(errno));
+		exit(1);
+	}
+
+	printf("%s: %u bytes of segments compressed to %u\n",
+	       argv[2], total, off - ZIMAGE_HDRSIZE);
+	return 0;
+}
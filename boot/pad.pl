@@ -0,0 +1,26 @@
+#!/usr/bin/perl
+
+# Pad the second-stage loader to a whole number of sectors.
+# usage: pad.pl file nsect
+
+open(LD, $ARGV[0]) || die "open $ARGV[0]: $!";
+$max = $ARGV[1] * 512;
+
+binmode LD;
+my $buf;
+read(LD, $buf, $max + 1);
+$n = length($buf);
+
+if($n > $max){
+	print STDERR "loader too large: $n bytes (max $max)\n";
+	exit 1;
+}
+
+print STDERR "loader is $n bytes (max $max)\n";
+
+$buf .= "\0" x ($max-$n);
+
+open(LD, ">$ARGV[0]") || die "open >$ARGV[0]: $!";
+binmode LD;
+print LD $buf;
+close LD;
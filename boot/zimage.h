@@ -0,0 +1,32 @@
+#ifndef JOS_BOOT_ZIMAGE_H
+#define JOS_BOOT_ZIMAGE_H
+
+/*
+ * Compressed kernel image, as written by boot/mkzimage and loaded by
+ * boot/loader.c.  The first page holds a struct Zimghdr followed by
+ * z_nseg struct Zsegs; the LZ4 block-compressed file contents of each
+ * loadable segment of the kernel ELF follow, back to back.
+ *
+ * Like inc/elf.h, this needs uint32_t but includes nothing, so that
+ * host tools can use it too.
+ */
+
+#define ZIMAGE_MAGIC	0x5A534F4AU	/* "JOSZ" in little endian */
+#define ZIMAGE_HDRSIZE	4096		/* Compressed data starts here */
+
+struct Zimghdr {
+	uint32_t z_magic;	// must equal ZIMAGE_MAGIC
+	uint32_t z_entry;	// Kernel entry point (physical)
+	uint32_t z_nseg;	// Number of struct Zsegs that follow
+	uint32_t z_size;	// Size of the whole image in bytes
+};
+
+struct Zseg {
+	uint32_t zs_offset;	// Image offset of the compressed data
+	uint32_t zs_csize;	// Compressed size
+	uint32_t zs_pa;		// Load address
+	uint32_t zs_filesz;	// Decompressed size
+	uint32_t zs_memsz;	// Size in memory; the rest is zeroed
+};
+
+#endif /* !JOS_BOOT_ZIMAGE_H */
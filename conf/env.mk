@@ -18,3 +18,8 @@ V = @
 # following line and set it to the full path to QEMU.
 #
 # QEMU=
+
+# If KERN_LZ4 is set to 1, the disk image carries an LZ4-compressed
+# kernel that the boot loader decompresses (see boot/zimage.h).
+#
+# KERN_LZ4=1
@@ -318,6 +318,7 @@ class GDBClient(object):
                 if time.time() >= start + timeout:
                     raise
         self.__buf = ""
+        self.stopped = False            # has the target hit a breakpoint?
 
     def fileno(self):
         if self.sock:
@@ -343,6 +344,7 @@ class GDBClient(object):
 
             if pkt.startswith("T05"):
                 # Breakpoint
+                self.stopped = True
                 raise TerminateTest
 
     def __send(self, cmd):
@@ -384,7 +386,14 @@ class Runner():
         TerminateTest when stop events occur.  The target_base
         argument gives the make target to run.  The make_args argument
         should be a list of additional arguments to pass to make.  The
-        timeout argument bounds how long to run before returning."""
+        timeout argument bounds how long to run before returning.
+
+        Afterwards, self.run_time holds the seconds from letting the
+        guest run until a monitor stopped it (or QEMU exited),
+        self.timed_out says whether the timeout ended the run instead,
+        and self.breakpoint_hit whether the guest stopped at a GDB
+        breakpoint (such as a stop_breakpoint monitor's), rather than
+        QEMU exiting or another monitor stopping it."""
 
         def run_qemu_kw(target_base="qemu", make_args=[], timeout=30):
             return target_base, make_args, timeout
@@ -415,8 +424,11 @@ class Runner():
                 m(self)
 
             # Run and react
+            start = time.time()
             self.gdb.cont()
-            self.__react(self.reactors, timeout)
+            self.timed_out = not self.__react(self.reactors, timeout)
+            self.run_time = time.time() - start
+            self.breakpoint_hit = self.gdb.stopped
         finally:
             # Shutdown QEMU
             try:
@@ -444,6 +456,9 @@ Failed to shutdown QEMU.  You might need to 'killall qemu' or
             raise TerminateTest
 
     def __react(self, reactors, timeout):
+        """React to input until a reactor stops the test or all of them
+        close.  Return False if the timeout expired first."""
+
         deadline = time.time() + timeout
         try:
             while True:
@@ -451,17 +466,18 @@ Failed to shutdown QEMU.  You might need to 'killall qemu' or
                 if timeleft < 0:
                     sys.stdout.write("Timeout! ")
                     sys.stdout.flush()
-                    return
+                    return False
 
                 rset = [r for r in reactors if r.fileno() is not None]
                 if not rset:
-                    return
+                    return True
 
                 rset, _, _ = select.select(rset, [], [], timeleft)
                 for reactor in rset:
                     reactor.handle_read()
         except TerminateTest:
             pass
+        return True
 
     def user_test(self, binary, *monitors, **kw):
         """Run a user test using the specified binary.  Monitors and
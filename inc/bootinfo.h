@@ -0,0 +1,77 @@
+#ifndef JOS_INC_BOOTINFO_H
+#define JOS_INC_BOOTINFO_H
+
+/*
+ * Boot information the second-stage loader (boot/loader.c) hands to
+ * the kernel.  Like a Multiboot loader, it enters the kernel with
+ * BOOTINFO_MAGIC in %eax and the physical address of a struct Bootinfo
+ * in %ebx.  The record lives at BOOTINFO_PADDR, in low memory the BIOS
+ * leaves free; the kernel copies it before it reuses that memory.
+ *
+ * When a Multiboot loader starts the kernel instead (see
+ * inc/multiboot.h), i386_init fills in its copy from the Multiboot
+ * information, so the rest of the kernel needs to look in one place.
+ */
+
+#define BOOTINFO_MAGIC		0x4A4F5321	// "!SOJ"
+#define BOOTINFO_PADDR		0x1000
+
+// Bootinfo flags
+#define BOOTINFO_BSSCLEAR	0x1	// Loader zeroed all p_memsz > p_filesz
+#define BOOTINFO_MEMORY		0x2	// mem_lower/mem_upper valid
+#define BOOTINFO_MMAP		0x4	// mmap/nmmap valid
+#define BOOTINFO_MODS		0x8	// mods/nmods valid
+
+#define BOOTINFO_MAXMMAP	16	// Memory map entries kept
+#define BOOTINFO_MAXMODS	8	// Boot modules kept
+
+// Boot timeline: read_tsc() stamps taken at fixed points on the way
+// into the kernel.  Each phase runs from the previous stamp to its own;
+// a zero stamp means that point was never recorded.
+#define BOOTTS_START		0	// boot.S: start
+#define BOOTTS_LOADER_READ	1	// bootmain: before reading the loader
+#define BOOTTS_LOADER_DONE	2	// bootmain: after reading the loader
+#define BOOTTS_KERN_READ	3	// loader: before reading the kernel
+#define BOOTTS_KERN_DONE	4	// loader: kernel loaded, about to jump
+#define BOOTTS_ENTRY		5	// entry.S: entry
+#define BOOTTS_BSS		6	// i386_init: BSS and boot info ready
+#define BOOTTS_CONS		7	// i386_init: after cons_init
+#define BOOTTS_INIT		8	// i386_init: about to enter the monitor
+#define NBOOTTS			9
+
+// Offset of the timeline in struct Bootinfo, for boot.S
+#define BOOTINFO_TSC		8
+
+#ifndef __ASSEMBLER__
+#include <inc/types.h>
+
+// A physical memory range from the BIOS memory map
+struct Bootmmap {
+	uint64_t addr;
+	uint64_t len;
+	uint32_t type;		// 1 means available RAM
+	uint32_t reserved;
+};
+
+// A boot module the loader placed in physical memory
+struct Bootmod {
+	physaddr_t start;
+	physaddr_t end;
+	physaddr_t cmdline;	// Physical address of its command line, or 0
+};
+
+struct Bootinfo {
+	uint32_t flags;
+	uint32_t reserved;
+	uint64_t tsc[NBOOTTS];	// boot timeline, indexed by BOOTTS_*
+
+	uint32_t mem_lower;	// KB of memory below 1MB
+	uint32_t mem_upper;	// KB of memory from 1MB to the first hole
+	uint32_t nmmap;
+	uint32_t nmods;
+	struct Bootmmap mmap[BOOTINFO_MAXMMAP];
+	struct Bootmod mods[BOOTINFO_MAXMODS];
+};
+#endif /* !__ASSEMBLER__ */
+
+#endif /* !JOS_INC_BOOTINFO_H */
@@ -86,6 +86,11 @@
 // All physical memory mapped at this address
 #define	KERNBASE	0xF0000000
 
+// Physical memory entry.S maps at KERNBASE, with 4MB pages, for use
+// until mem_init sets up the real page tables.  A multiple of PTSIZE,
+// at most 4GB - KERNBASE.
+#define EARLYMEM	(64*PTSIZE)
+
 // At IOPHYSMEM (640K) there is a 384K hole for I/O.  From the kernel,
 // IOPHYSMEM can be addressed at KERNBASE + IOPHYSMEM.  The hole ends
 // at physical address EXTPHYSMEM.
@@ -0,0 +1,62 @@
+#ifndef JOS_INC_MULTIBOOT_H
+#define JOS_INC_MULTIBOOT_H
+
+/*
+ * The parts of the Multiboot 0.6.96 specification the kernel uses.
+ * A Multiboot loader (GRUB, or QEMU's -kernel) finds the header in the
+ * first 8KB of the kernel image, loads the ELF segments itself, and
+ * enters the kernel with MULTIBOOT_BOOTLOADER_MAGIC in %eax and the
+ * physical address of a struct Mbinfo in %ebx.
+ */
+
+#define MULTIBOOT_HEADER_MAGIC		0x1BADB002
+#define MULTIBOOT_BOOTLOADER_MAGIC	0x2BADB002
+
+// Multiboot header flags
+#define MULTIBOOT_PAGE_ALIGN		0x00000001	// Page-align modules
+#define MULTIBOOT_MEMORY_INFO		0x00000002	// Want mem_* and mmap_*
+
+// Multiboot info flags
+#define MULTIBOOT_INFO_MEMORY		0x00000001	// mem_lower/mem_upper valid
+#define MULTIBOOT_INFO_MODS		0x00000008	// mods_* valid
+#define MULTIBOOT_INFO_MMAP		0x00000040	// mmap_* valid
+
+// Memory map entry types
+#define MULTIBOOT_MEMORY_AVAILABLE	1
+
+#ifndef __ASSEMBLER__
+#include <inc/types.h>
+
+// Multiboot information block, up to the memory map
+struct Mbinfo {
+	uint32_t flags;
+	uint32_t mem_lower;	// KB of memory below 1MB
+	uint32_t mem_upper;	// KB of memory from 1MB to the first hole
+	uint32_t boot_device;
+	uint32_t cmdline;	// Physical address of the command line
+	uint32_t mods_count;
+	uint32_t mods_addr;	// Physical address of a struct Mbmod array
+	uint32_t syms[4];
+	uint32_t mmap_length;	// Size of the memory map in bytes
+	uint32_t mmap_addr;	// Physical address of the memory map
+};
+
+// Memory map entry.  size counts the bytes that follow it, so entries
+// are walked by adding size + 4, not sizeof(struct Mbmmap).
+struct Mbmmap {
+	uint32_t size;
+	uint64_t addr;
+	uint64_t len;
+	uint32_t type;
+} __attribute__((packed));
+
+// Boot module
+struct Mbmod {
+	uint32_t mod_start;	// Physical address of the module
+	uint32_t mod_end;	// ... and of its end
+	uint32_t string;	// Physical address of its command line
+	uint32_t reserved;
+};
+#endif /* !__ASSEMBLER__ */
+
+#endif /* !JOS_INC_MULTIBOOT_H */
@@ -1,6 +1,7 @@
 #ifndef JOS_INC_STDIO_H
 #define JOS_INC_STDIO_H
 
+#include <inc/types.h>
 #include <inc/stdarg.h>
 
 #ifndef NULL
@@ -13,14 +14,64 @@ int	getchar(void);
 int	iscons(int fd);
 
 // lib/printfmt.c
+// Where vprintfmt_ops sends its output.  putstr may be NULL; if not,
+// it gets runs of characters at once instead of through putch.
+struct Printops {
+	void	(*putch)(int ch, void *putdat);
+	void	(*putstr)(const char *s, size_t len, void *putdat);
+};
 void	printfmt(void (*putch)(int, void*), void *putdat, const char *fmt, ...);
 void	vprintfmt(void (*putch)(int, void*), void *putdat, const char *fmt, va_list);
+void	vprintfmt_ops(const struct Printops *ops, void *putdat, const char *fmt, va_list);
+
+// One %-escape sequence, parsed
+struct Fmtspec {
+	char	conv;		// 'd', 's', ..., or 0 at the end of the format
+	char	padc;
+	uint8_t	lflag;
+	uint8_t	altflag;
+	uint8_t	star;		// where a '*' argument goes: FMTSTAR_*
+	int	width;
+	int	precision;
+};
+
+#define FMTSTAR_NONE		0
+#define FMTSTAR_WIDTH		1
+#define FMTSTAR_PRECISION	2
+
+// A run of literal text at fmt + off, then a conversion
+struct Fmtop {
+	uint16_t off;
+	uint16_t len;
+	struct Fmtspec spec;
+};
+
+#define FMTCACHE_NOPS	16
+
+// A constant format string, parsed by its first vprintfmt_cached.
+// nops is 0 until then, and -1 if the format can't be cached.
+struct Fmtcache {
+	int	nops;
+	struct Fmtop ops[FMTCACHE_NOPS];
+};
+
+void	vprintfmt_cached(const struct Printops *ops, void *putdat, struct Fmtcache *fc, const char *fmt, va_list);
 int	snprintf(char *str, int size, const char *fmt, ...);
 int	vsnprintf(char *str, int size, const char *fmt, va_list);
 
 // lib/printf.c
 int	cprintf(const char *fmt, ...);
 int	vcprintf(const char *fmt, va_list);
+int	cprintf_cached(struct Fmtcache *fc, const char *fmt, ...);
+
+// cprintf for a call site that runs often with a constant format: the
+// format is parsed once, into a descriptor private to the call site,
+// and later calls reuse that parse.  So fmt must be a string literal
+// (anything else fails to compile), never a variable.
+#define CPRINTF_STATIC(fmt, ...) ({					\
+	static struct Fmtcache __fc;					\
+	cprintf_cached(&__fc, "" fmt "", ##__VA_ARGS__);		\
+})
 
 // lib/fprintf.c
 int	printf(const char *fmt, ...);
@@ -5,20 +5,34 @@
 #include <inc/kbdreg.h>
 #include <inc/string.h>
 #include <inc/assert.h>
+#include <inc/error.h>
+#include <inc/trap.h>
 
 #include <kern/console.h>
+#include <kern/picirq.h>
 
 static void cons_intr(int (*proc)(void));
 static void cons_putc(int c);
+static void cons_push(void);
+
+struct Consprof cons_prof;
 
 // Stupid I/O delay routine necessitated by historical PC design flaws
 static void
 delay(void)
 {
+	uint64_t t0 = 0;
+
+	if (cons_prof.on)
+		t0 = read_tsc();
 	inb(0x84);
 	inb(0x84);
 	inb(0x84);
 	inb(0x84);
+	if (cons_prof.on) {
+		cons_prof.delays++;
+		cons_prof.delay_cycles += read_tsc() - t0;
+	}
 }
 
 /***** Serial I/O code *****/
@@ -35,8 +49,17 @@ delay(void)
 #define COM_DLM		1	// Out: Divisor Latch High (DLAB=1)
 #define COM_IER		1	// Out: Interrupt Enable Register
 #define   COM_IER_RDI	0x01	//   Enable receiver data interrupt
+#define   COM_IER_TXI	0x02	//   Enable transmitter empty interrupt
 #define COM_IIR		2	// In:	Interrupt ID Register
+#define   COM_IIR_NOPEND 0x01	//   No interrupt pending
+#define   COM_IIR_FIFO64 0x20	//   64-byte FIFOs enabled (16750)
+#define   COM_IIR_FIFO	0xC0	//   FIFOs enabled (16550A)
 #define COM_FCR		2	// Out: FIFO Control Register
+#define   COM_FCR_ENABLE 0x01	//   Enable FIFOs
+#define   COM_FCR_RCLR	0x02	//   Clear receive FIFO
+#define   COM_FCR_XCLR	0x04	//   Clear transmit FIFO
+#define   COM_FCR_FIFO64 0x20	//   64-byte FIFOs (16750; needs DLAB)
+#define   COM_FCR_TRIGGER8 0x80	//   Receive interrupt at 8 bytes (32 on 16750)
 #define COM_LCR		3	// Out: Line Control Register
 #define	  COM_LCR_DLAB	0x80	//   Divisor latch access bit
 #define	  COM_LCR_WLEN8	0x03	//   Wordlength: 8 bits
@@ -46,64 +69,203 @@ delay(void)
 #define	  COM_MCR_OUT2	0x08	// Out2 complement
 #define COM_LSR		5	// In:	Line Status Register
 #define   COM_LSR_DATA	0x01	//   Data available
+#define   COM_LSR_OE	0x02	//   Overrun error
 #define   COM_LSR_TXRDY	0x20	//   Transmit buffer avail
 #define   COM_LSR_TSRE	0x40	//   Transmitter off
 
+// Line speed.  The divisor latch divides 115200; override with, e.g.,
+// make DEFS=-DCOM_BAUD=9600
+#ifndef COM_BAUD
+#define COM_BAUD	115200
+#endif
+
 static bool serial_exists;
+static int serial_fifo;		// Transmit FIFO depth, 1 if none
+static uint8_t serial_ier;	// What we last wrote to COM_IER
+static bool serial_stopped;	// We deasserted RTS to stop the sender
+
+// Output waiting for the UART.  serial_tx moves it into the transmit
+// FIFO a FIFO-full at a time, from the THRE interrupt once interrupts
+// are on, so that writers don't have to wait out each byte.
+#define SERTXSIZE 1024
+
+static struct {
+	uint8_t buf[SERTXSIZE];
+	uint32_t rpos;
+	uint32_t wpos;
+} sertx;
 
 // 返回从 COM1 端口读入的数据
 // COM_LSR 寄存器的
 // bit 0 = 1 表示 data ready. a complete incoming character has been received and sent to the receiver buffer register.
+// Read the line status register.  Reading it clears the overrun bit,
+// so count overruns here, whoever is asking.
+static uint8_t
+serial_lsr(void)
+{
+	uint64_t t0 = 0;
+	uint8_t lsr;
+
+	if (cons_prof.on)
+		t0 = read_tsc();
+	lsr = inb(COM1+COM_LSR);
+	if (cons_prof.on) {
+		cons_prof.lsr_polls++;
+		cons_prof.lsr_cycles += read_tsc() - t0;
+	}
+	if (lsr & COM_LSR_OE)
+		cons_stats.serial_overruns++;
+	return lsr;
+}
+
 static 
 int serial_proc_data(void)
 {
-	if (!(inb(COM1+COM_LSR) & COM_LSR_DATA))
+	if (!(serial_lsr() & COM_LSR_DATA))
 		return -1;
 	return inb(COM1+COM_RX);
 }
 
+// Hardware flow control for input: deassert RTS to ask the other end
+// to stop sending, and assert it again to let it go on.
+static void
+serial_rts(bool on)
+{
+	if (!serial_exists || serial_stopped == !on)
+		return;
+	serial_stopped = !on;
+	if (serial_stopped)
+		cons_stats.serial_throttles++;
+	outb(COM1+COM_MCR, COM_MCR_DTR | COM_MCR_OUT2 | (on ? COM_MCR_RTS : 0));
+}
+
+
+// If the transmitter is empty, refill it from the queue.  Ask for a
+// THRE interrupt exactly while there is more queued output.
+// Call with interrupts disabled.
+static void
+serial_tx(void)
+{
+	uint8_t ier;
+	int n;
+
+	if (serial_lsr() & COM_LSR_TXRDY)
+		for (n = 0; n < serial_fifo && sertx.rpos != sertx.wpos; n++) {
+			outb(COM1 + COM_TX, sertx.buf[sertx.rpos++]);
+			if (sertx.rpos == SERTXSIZE)
+				sertx.rpos = 0;
+		}
+
+	ier = COM_IER_RDI | (sertx.rpos != sertx.wpos ? COM_IER_TXI : 0);
+	if (ier != serial_ier)
+		outb(COM1 + COM_IER, (serial_ier = ier));
+}
+
+// Wait, polling, for the UART to take some queued output.  If it takes
+// nothing for 12800 delays, assume it never will and drop the queue.
+static void
+serial_txwait(void)
+{
+	uint32_t eflags, rpos;
+	int i;
+
+	eflags = read_eflags();
+	asm volatile("cli" ::: "memory");
+	rpos = sertx.rpos;
+	for (i = 0; sertx.rpos == rpos && sertx.rpos != sertx.wpos; i++) {
+		if (i == 12800) {
+			sertx.rpos = sertx.wpos;
+			break;
+		}
+		delay();
+		serial_tx();
+	}
+	write_eflags(eflags);
+}
 
 // 将读入的数据放入输入串口
+// Also the IRQ 4 handler: the UART interrupts both for received data
+// and for an empty transmitter.  The 8259 is edge-triggered, so keep
+// going until the UART has nothing more to say.
 void
 serial_intr(void)
 {
-	if (serial_exists)
+	uint32_t eflags;
+	int i;
+
+	if (!serial_exists)
+		return;
+	eflags = read_eflags();
+	asm volatile("cli" ::: "memory");
+	for (i = 0; i < 16; i++) {
 		cons_intr(serial_proc_data);
+		serial_tx();
+		if (inb(COM1 + COM_IIR) & COM_IIR_NOPEND)
+			break;
+	}
+	write_eflags(eflags);
 }
 
 // 将输出放入输出串口
 static void
-serial_putc(int c)
+serial_write(const char *s, size_t n)
 {
-	int i;
-
-	for (i = 0; !(inb(COM1 + COM_LSR) & COM_LSR_TXRDY) && i < 12800; i++)
-		delay();
+	uint32_t eflags, next;
+
+	eflags = read_eflags();
+	asm volatile("cli" ::: "memory");
+	for (; n > 0; n--) {
+		next = sertx.wpos + 1;
+		if (next == SERTXSIZE)
+			next = 0;
+		while (next == sertx.rpos)
+			serial_txwait();
+		sertx.buf[sertx.wpos] = *s++;
+		sertx.wpos = next;
+	}
+	serial_tx();
+	write_eflags(eflags);
+}
 
-	outb(COM1 + COM_TX, c);
+// Wait until all queued output has gone to the UART
+static void
+serial_flush(void)
+{
+	while (sertx.rpos != sertx.wpos)
+		serial_txwait();
 }
 
 // 初始化串行端口
-static void
+static bool
 serial_init(void)
 {
-	// Turn off the FIFO
-	
-	// 将 FIFO 控制寄存器设置为 0
-	outb(COM1+COM_FCR, 0);
+	uint8_t iir;
 
-	// Set speed; requires DLAB latch
+	// Set speed; requires DLAB latch.  Turn on and clear the FIFOs
+	// while DLAB is set, when a 16750 also accepts the 64-byte bit.
 	outb(COM1+COM_LCR, COM_LCR_DLAB);
-	outb(COM1+COM_DLL, (uint8_t) (115200 / 9600));
-	outb(COM1+COM_DLM, 0);
+	outb(COM1+COM_FCR, COM_FCR_ENABLE | COM_FCR_RCLR | COM_FCR_XCLR
+	     | COM_FCR_FIFO64 | COM_FCR_TRIGGER8);
+	outb(COM1+COM_DLL, (uint8_t) (115200 / COM_BAUD));
+	outb(COM1+COM_DLM, (uint8_t) ((115200 / COM_BAUD) >> 8));
 
 	// 8 data bits, 1 stop bit, parity off; turn off DLAB latch
 	outb(COM1+COM_LCR, COM_LCR_WLEN8 & ~COM_LCR_DLAB);
 
-	// No modem controls
-	outb(COM1+COM_MCR, 0);
+	// Size the transmit FIFO: the IIR says whether the FIFOs took.
+	// An 8250/16450 has none, and an original 16550's doesn't work.
+	iir = inb(COM1+COM_IIR);
+	if ((iir & COM_IIR_FIFO) == COM_IIR_FIFO)
+		serial_fifo = (iir & COM_IIR_FIFO64) ? 64 : 16;
+	else {
+		outb(COM1+COM_FCR, 0);
+		serial_fifo = 1;
+	}
+
+	// Assert DTR and RTS; OUT2 gates the UART's interrupt line
+	outb(COM1+COM_MCR, COM_MCR_DTR | COM_MCR_RTS | COM_MCR_OUT2);
 	// Enable rcv interrupts
-	outb(COM1+COM_IER, COM_IER_RDI);
+	outb(COM1+COM_IER, (serial_ier = COM_IER_RDI));
 
 	// Clear any preexisting overrun indications and interrupts
 	// Serial port doesn't exist if COM_LSR returns 0xFF
@@ -113,6 +275,10 @@ serial_init(void)
 	(void) inb(COM1+COM_IIR);
 	(void) inb(COM1+COM_RX);
 
+	// Enable serial interrupts
+	if (serial_exists)
+		irq_setmask_8259A(irq_mask_8259A & ~(1<<IRQ_SERIAL));
+	return serial_exists;
 }
 
 
@@ -133,6 +299,24 @@ lpt_putc(int c)
 	outb(0x378+2, 0x08);
 }
 
+static void
+lpt_write(const char *s, size_t n)
+{
+	for (; n > 0; n--)
+		lpt_putc(*s++);
+}
+
+// There is a port if its data register holds what we write to it
+static bool
+lpt_init(void)
+{
+	outb(0x378+0, 0xA5);
+	if (inb(0x378+0) != 0xA5)
+		return 0;
+	outb(0x378+0, 0x5A);
+	return inb(0x378+0) == 0x5A;
+}
+
 
 
 
@@ -148,8 +332,13 @@ static uint16_t *crt_buf;
 // 控制台的输出
 static uint16_t crt_pos;
 // 光标的位置, 输出缓冲字符的个数
+// The text buffer is a ring bigger than the screen: the screen shows
+// the CRT_SIZE characters from crt_start on, and scrolling moves
+// crt_start instead of the text.  crt_pos counts from crt_buf too.
+static uint16_t crt_start;
+static uint16_t crt_ringsize;		// characters in the text buffer
 
-static void
+static bool
 cga_init(void)
 {
 	volatile uint16_t *cp;
@@ -163,11 +352,20 @@ cga_init(void)
 	if (*cp != 0xA55A) {
 		cp = (uint16_t*) (KERNBASE + MONO_BUF);
 		addr_6845 = MONO_BASE;
+		crt_ringsize = MONO_BUFSIZE / sizeof(uint16_t);
 	} else {
 		*cp = was;
 		addr_6845 = CGA_BASE;
+		crt_ringsize = CGA_BUFSIZE / sizeof(uint16_t);
 	}
 
+	// Show the text from the start of the buffer, which is where
+	// the BIOS left the cursor position counting from.
+	outb(addr_6845, 12);
+	outb(addr_6845 + 1, 0);
+	outb(addr_6845, 13);
+	outb(addr_6845 + 1, 0);
+
 	// 提取出光标的位置
 	/* Extract cursor location */
 	outb(addr_6845, 14);
@@ -177,57 +375,88 @@ cga_init(void)
 
 	crt_buf = (uint16_t*) cp;
 	crt_pos = pos;
+	return 1;
 }
 
 
-// 从光标处输出一个字符
+// Scroll by moving the screen a row down the ring.  Only when it would
+// run off the end of the buffer do we copy the rows still on screen
+// back to the start.
 static void
-cga_putc(int c)
-{
-	// if no attribute given, then use black on white
-	if (!(c & ~0xFF))
-		c |= 0x0700;
-	// 改变输出背景颜色
-
-	switch (c & 0xff) {
-		// 往回退一格子
-	case '\b':
-		if (crt_pos > 0) {
-			crt_pos--;
-			crt_buf[crt_pos] = (c & ~0xff) | ' ';
-		}
-		break;
-	case '\n':
-		crt_pos += CRT_COLS;
-		/* fallthru */
-	case '\r':
-	// 回车
-		crt_pos -= (crt_pos % CRT_COLS);
-		break;
-	case '\t':
-	// 水平制表符
-		cons_putc(' ');
-		cons_putc(' ');
-		cons_putc(' ');
-		cons_putc(' ');
-		cons_putc(' ');
-		break;
-	default:
-		crt_buf[crt_pos++] = c;		/* write the character */
-		break;
+cga_scroll(void)
+{
+	int i;
+
+	crt_start += CRT_COLS;
+	if (crt_start + CRT_SIZE > crt_ringsize) {
+		memmove(crt_buf, crt_buf + crt_start, (CRT_SIZE - CRT_COLS) * sizeof(uint16_t));
+		crt_pos -= crt_start;
+		crt_start = 0;
 	}
+	// 下面是将最后一行换成空格, 黑色的底
+	for (i = crt_start + CRT_SIZE - CRT_COLS; i < crt_start + CRT_SIZE; i++)
+		crt_buf[i] = 0x0700 | ' ';
+
+	outb(addr_6845, 12);
+	outb(addr_6845 + 1, crt_start >> 8);
+	outb(addr_6845, 13);
+	outb(addr_6845 + 1, crt_start);
+}
+
+static bool
+cga_ctrl(int c)
+{
+	return c == '\b' || c == '\n' || c == '\r' || c == '\t';
+}
+
+// 从光标处输出字符
+// Write n characters at the cursor, black on white, and move the
+// cursor once at the end.
+static void
+cga_write(const char *s, size_t n)
+{
+	const char *end = s + n;
+	uint16_t lim;
+	int c, i;
+
+	while (s < end) {
+		c = (uint8_t) *s++;
+		switch (c) {
+			// 往回退一格子
+		case '\b':
+			if (crt_pos > crt_start) {
+				crt_pos--;
+				crt_buf[crt_pos] = 0x0700 | ' ';
+			}
+			break;
+		case '\n':
+			crt_pos += CRT_COLS;
+			/* fallthru */
+		case '\r':
+		// 回车
+			crt_pos -= (crt_pos % CRT_COLS);
+			break;
+		case '\t':
+		// 水平制表符
+			for (i = 0; i < 5; i++) {
+				crt_buf[crt_pos++] = 0x0700 | ' ';
+				if (crt_pos >= crt_start + CRT_SIZE)
+					cga_scroll();
+			}
+			break;
+		default:
+			// the whole run of ordinary characters, up to the
+			// bottom of the screen
+			crt_buf[crt_pos++] = 0x0700 | c;
+			lim = crt_start + CRT_SIZE;
+			while (s < end && crt_pos < lim && !cga_ctrl(*s))
+				crt_buf[crt_pos++] = 0x0700 | (uint8_t) *s++;
+			break;
+		}
 
-	// What is the purpose of this?
-	if (crt_pos >= CRT_SIZE) {
 		// 位置超过了屏幕大小
-		int i;
-		memmove(crt_buf, crt_buf + CRT_COLS, (CRT_SIZE - CRT_COLS) * sizeof(uint16_t));
-		// crt_buf + CRT_COLS 表示添加一行的数目, CRT_COLS 表示的是列的个数
-		// 将所有的行往前移动一行
-		// 下面是将最后一行换成空格, 黑色的底
-		for (i = CRT_SIZE - CRT_COLS; i < CRT_SIZE; i++)
-			crt_buf[i] = 0x0700 | ' ';
-		crt_pos -= CRT_COLS;
+		if (crt_pos >= crt_start + CRT_SIZE)
+			cga_scroll();
 	}
 
 	// 移动光标
@@ -406,6 +635,9 @@ kbd_intr(void)
 static void
 kbd_init(void)
 {
+	// Drain the kbd buffer so that QEMU generates interrupts.
+	kbd_intr();
+	irq_setmask_8259A(irq_mask_8259A & ~(1<<IRQ_KBD));
 }
 
 
@@ -416,76 +648,237 @@ kbd_init(void)
 // whenever the corresponding interrupt occurs.
 // 缓冲区结构体
 // 当有对应的中断发生时， 将串行端口或者键盘输入送入缓冲区
-#define CONSBUFSIZE 512
+// When the buffer fills up, the newest input is dropped (and counted)
+// so that what was typed first survives.  Before it comes to that, the
+// serial port's RTS line stops the other end at CONS_HIWAT characters
+// and lets it go again once the buffer is down to CONS_LOWAT, which
+// leaves room for whatever is already on its way.
+#define CONSBUFSIZE 4096
+#define CONS_HIWAT (CONSBUFSIZE * 3 / 4)
+#define CONS_LOWAT (CONSBUFSIZE / 4)
 
 static struct {
 	uint8_t buf[CONSBUFSIZE];
-	// 大小是 512 字节
+	// 大小是 4096 字节
 	uint32_t rpos;
 	// 读位置
 	uint32_t wpos;
 	// 应该是装入的字符的个数, 写入的位置
 } cons;
 
+struct Consstats cons_stats;
+
+// number of characters waiting in the input buffer
+static uint32_t
+cons_count(void)
+{
+	return (cons.wpos + CONSBUFSIZE - cons.rpos) % CONSBUFSIZE;
+}
+
 // called by device interrupt routines to feed input characters into the circular console input buffer.
 // 将输入字符放入缓冲区
 // 设备中断是指, 比如说正在运行其他程序, 键盘开始输入, 需要中断其他程序
 static void
 cons_intr(int (*proc)(void))
 {
+	uint32_t next;
 	int c;
 
 	while ((c = (*proc)()) != -1) {
 		if (c == 0)
 			continue;
-		cons.buf[cons.wpos++] = c;
+		next = cons.wpos + 1;
+		if (next == CONSBUFSIZE)
+			next = 0;
 		// 如果缓冲区满了
-		if (cons.wpos == CONSBUFSIZE)
-			cons.wpos = 0;
+		if (next == cons.rpos) {
+			cons_stats.in_dropped++;
+			continue;
+		}
+		cons.buf[cons.wpos] = c;
+		cons.wpos = next;
 	}
+
+	if (cons_count() >= CONS_HIWAT)
+		serial_rts(0);
 }
 
 // return the next input character from the console, or 0 if none waiting
 int
 cons_getc(void)
 {
+	uint32_t eflags;
 	int c;
 
-	// poll for any pending input characters,
-	// so that this function works even when interrupts are disabled
-	// (e.g., when called from the kernel monitor).
-	serial_intr();
-	kbd_intr();
+	// whoever is waiting for input should see all output so far
+	cons_flush();
+
+	// poll for any pending input characters if interrupts are off,
+	// so that this function works even then (e.g., when called from
+	// the kernel monitor after a panic).  Otherwise IRQs 1 and 4
+	// fill the input buffer.
+	if (!(read_eflags() & FL_IF)) {
+		serial_intr();
+		kbd_intr();
+	}
 
 	// grab the next character from the input buffer.
+	eflags = read_eflags();
+	asm volatile("cli" ::: "memory");
+	c = 0;
 	if (cons.rpos != cons.wpos) {
 		c = cons.buf[cons.rpos++];
 		if (cons.rpos == CONSBUFSIZE)
 			cons.rpos = 0;
-		return c;
+		if (cons_count() <= CONS_LOWAT)
+			serial_rts(1);
 	}
-	return 0;
+	write_eflags(eflags);
+	return c;
 }
 
+// Console output goes through this ring, so that printing doesn't wait
+// on the devices a character at a time.  cons_push hands it to the
+// devices when a line is complete or the ring fills up; cons_flush
+// also waits for the serial port to send it, before reading input
+// and on panic.
+#define CONSOUTSIZE 4096
+
+static struct {
+	char buf[CONSOUTSIZE];
+	uint32_t rpos;
+	uint32_t wpos;
+} consout;
+
 // output a character to the console
 static void
 cons_putc(int c)
 {
+	uint32_t next = consout.wpos + 1;
+
+	if (next == CONSOUTSIZE)
+		next = 0;
+	// if the ring is full, make room the only way we can
+	if (next == consout.rpos)
+		cons_push();
+	consout.buf[consout.wpos] = c;
+	consout.wpos = next;
+
+	if ((c & 0xff) == '\n')
+		cons_push();
+}
+
+// output n characters to the console, copying them into the ring in
+// as few pieces as will fit
+void
+cons_write(const char *s, size_t n)
+{
+	uint32_t room;
+	bool nl = 0;
+
+	while (n > 0) {
+		// the contiguous free part, up to rpos or the end of the ring
+		if (consout.rpos > consout.wpos)
+			room = consout.rpos - 1 - consout.wpos;
+		else
+			room = CONSOUTSIZE - (consout.rpos == 0) - consout.wpos;
+		if (room == 0) {
+			cons_push();
+			continue;
+		}
+		room = MIN(room, n);
+		memcpy(&consout.buf[consout.wpos], s, room);
+		nl = nl || memfind(s, '\n', room) != s + room;
+		consout.wpos += room;
+		if (consout.wpos == CONSOUTSIZE)
+			consout.wpos = 0;
+		s += room;
+		n -= room;
+	}
+
+	if (nl)
+		cons_push();
+}
+
+// The console output devices, in the order they get output.
+// cons_init probes each one and enables those that are present.
+struct Conssink cons_sinks[] = {
 	// 将输出放入输出串口
-	serial_putc(c);
+	{ "serial", serial_init, serial_write, serial_flush },
 	// 串口并行化
-	lpt_putc(c);
-	// 从光标处输出一个字符
-	cga_putc(c);
+	{ "lpt", lpt_init, lpt_write, NULL },
+	// 从光标处输出字符
+	{ "cga", cga_init, cga_write, NULL },
+};
+const int ncons_sinks = ARRAY_SIZE(cons_sinks);
+
+// hand all buffered output to the console devices
+static void
+cons_push(void)
+{
+	struct Conssink *sink;
+	const char *p;
+	uint32_t n;
+
+	while (consout.rpos != consout.wpos) {
+		// the contiguous part, up to wpos or the end of the ring
+		p = &consout.buf[consout.rpos];
+		n = (consout.wpos > consout.rpos ? consout.wpos : CONSOUTSIZE) - consout.rpos;
+		for (sink = cons_sinks; sink < cons_sinks + ncons_sinks; sink++)
+			if (sink->enabled)
+				sink->write(p, n);
+
+		consout.rpos += n;
+		if (consout.rpos == CONSOUTSIZE)
+			consout.rpos = 0;
+	}
+}
+
+// push all buffered output out of the console devices
+void
+cons_flush(void)
+{
+	struct Conssink *sink;
+
+	cons_push();
+	for (sink = cons_sinks; sink < cons_sinks + ncons_sinks; sink++)
+		if (sink->enabled && sink->flush)
+			sink->flush();
+}
+
+// Turn output to the named device on or off.  Fails if there is no
+// such device, if it is not present, or if it is the last one on.
+int
+cons_sink_enable(const char *name, bool on)
+{
+	struct Conssink *sink, *s;
+	int n = 0;
+
+	for (sink = cons_sinks; sink < cons_sinks + ncons_sinks; sink++)
+		if (strcmp(sink->name, name) == 0)
+			break;
+	if (sink == cons_sinks + ncons_sinks || (on && !sink->present))
+		return -E_INVAL;
+
+	for (s = cons_sinks; s < cons_sinks + ncons_sinks; s++)
+		n += s->enabled && s != sink;
+	if (!on && n == 0)
+		return -E_INVAL;
+
+	cons_flush();
+	sink->enabled = on;
+	return 0;
 }
 
 // initialize the console devices
 void
 cons_init(void)
 {
-	cga_init();
+	struct Conssink *sink;
+
+	for (sink = cons_sinks; sink < cons_sinks + ncons_sinks; sink++)
+		sink->present = sink->enabled = sink->probe();
 	kbd_init();
-	serial_init();
 
 	if (!serial_exists)
 		cprintf("Serial port does not exist!\n");
@@ -505,8 +898,21 @@ getchar(void)
 {
 	int c;
 
+	// With interrupts off, cons_getc polls the devices; just spin.
+	if (!(read_eflags() & FL_IF)) {
+		while ((c = cons_getc()) == 0)
+			/* do nothing */;
+		return c;
+	}
+
+	// Otherwise halt until an input interrupt arrives.  Check for
+	// input with interrupts off, so that none can slip in between
+	// the check and the hlt: sti takes effect only after the next
+	// instruction.  (This also has cons_getc poll once per wakeup.)
+	asm volatile("cli" ::: "memory");
 	while ((c = cons_getc()) == 0)
-		/* do nothing */;
+		asm volatile("sti; hlt; cli" ::: "memory");
+	asm volatile("sti" ::: "memory");
 	return c;
 }
 
@@ -10,15 +10,53 @@
 
 #define MONO_BASE	0x3B4
 #define MONO_BUF	0xB0000
+#define MONO_BUFSIZE	0x1000		// bytes of text memory on an MDA
 #define CGA_BASE	0x3D4
 #define CGA_BUF		0xB8000
+#define CGA_BUFSIZE	0x4000		// bytes of text memory on a CGA
 
 #define CRT_ROWS	25
 #define CRT_COLS	80
 #define CRT_SIZE	(CRT_ROWS * CRT_COLS)
 
+// A console output device
+struct Conssink {
+	const char *name;
+	bool (*probe)(void);		// Set the device up; false if absent
+	void (*write)(const char *s, size_t n);
+	void (*flush)(void);		// Wait for written output, or NULL
+	bool present;
+	bool enabled;			// Gets console output
+};
+
+extern struct Conssink cons_sinks[];
+extern const int ncons_sinks;
+
+// Console input statistics
+struct Consstats {
+	uint32_t in_dropped;		// Input lost to a full input buffer
+	uint32_t serial_overruns;	// Input the UART lost before we read it
+	uint32_t serial_throttles;	// Times RTS stopped the serial sender
+};
+
+extern struct Consstats cons_stats;
+
+// Where console output waits, counted while 'on' is set
+struct Consprof {
+	bool on;
+	uint32_t delays;		// Calls to delay()
+	uint64_t delay_cycles;
+	uint32_t lsr_polls;		// Reads of the UART's line status
+	uint64_t lsr_cycles;
+};
+
+extern struct Consprof cons_prof;
+
 void cons_init(void);
 int cons_getc(void);
+void cons_flush(void);
+void cons_write(const char *s, size_t n);
+int cons_sink_enable(const char *name, bool on);
 
 void kbd_intr(void); // irq 1
 void serial_intr(void); // irq 4
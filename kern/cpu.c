@@ -0,0 +1,30 @@
+/* See COPYRIGHT for copyright information. */
+
+#include <inc/assert.h>
+#include <inc/x86.h>
+
+#include <kern/cpu.h>
+
+// CPUs that have run cpu_init
+static uint32_t ncpu_started;
+
+// Fill in this CPU's struct Cpuinfo; call once per CPU, on its own
+// kernel stack.  Indexes go in boot order, so each CPU gets its own
+// per-CPU slots (the cprintf log rings count on having one writer)
+// however sparse the APIC IDs are.
+void
+cpu_init(void)
+{
+	struct Cpuinfo *ci = thiscpu();
+	uint32_t id, ebx;
+
+	id = 1;
+	asm volatile("lock; xaddl %0, %1"
+		     : "+r" (id), "+m" (ncpu_started) : : "cc", "memory");
+	assert(id < NCPU);
+
+	// The initial local APIC ID, CPUID leaf 1 EBX bits 31-24
+	cpuid(1, NULL, &ebx, NULL, NULL);
+	ci->cpu_id = id;
+	ci->cpu_apicid = ebx >> 24;
+}
@@ -0,0 +1,38 @@
+#ifndef JOS_KERN_CPU_H
+#define JOS_KERN_CPU_H
+#ifndef JOS_KERNEL
+# error "This is a JOS kernel header; user programs should not #include it"
+#endif
+
+#include <inc/types.h>
+#include <inc/memlayout.h>
+#include <inc/x86.h>
+
+// Maximum number of CPUs
+#define NCPU  8
+
+// Per-CPU data, at the bottom of each CPU's kernel stack.  Kernel
+// stacks are KSTKSIZE-aligned (bootstack in kern/entry.S, and the
+// per-CPU stacks of inc/memlayout.h), so %esp finds it without CPUID,
+// which is serializing and makes a VM exit under virtualization.
+struct Cpuinfo {
+	int cpu_id;		// index into per-CPU arrays, < NCPU
+	int cpu_apicid;		// initial local APIC ID
+};
+
+static inline struct Cpuinfo *
+thiscpu(void)
+{
+	return (struct Cpuinfo *) ROUNDDOWN(read_esp(), KSTKSIZE);
+}
+
+// The index of the CPU we are running on, once it has run cpu_init
+static inline int
+cpunum(void)
+{
+	return thiscpu()->cpu_id;
+}
+
+void cpu_init(void);
+
+#endif	// !JOS_KERN_CPU_H
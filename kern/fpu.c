@@ -0,0 +1,69 @@
+/* See COPYRIGHT for copyright information. */
+
+#include <inc/mmu.h>
+#include <inc/x86.h>
+
+#include <kern/fpu.h>
+
+#define CPUID1_EDX_FXSR	(1 << 24)
+#define CPUID1_EDX_SSE	(1 << 25)
+#define CPUID1_EDX_SSE2	(1 << 26)
+
+// Default sizes from which lib/string.c uses SSE2.  Below them, the
+// saving and restoring in kfpu_begin/end, plus the alignment work,
+// eat up what SSE2 gains over the string instructions.
+#define SSE2_COPY_MIN	2048
+#define SSE2_SET_MIN	2048
+#define SSE2_CMP_MIN	256
+
+bool fpu_sse2;
+
+// Turn on the FPU and, if the CPU has them, FXSAVE and SSE
+void
+fpu_init(void)
+{
+	uint32_t edx;
+
+	// FPU present and not emulated; FWAIT honors CR0_TS
+	lcr0((rcr0() & ~(CR0_EM | CR0_TS)) | CR0_MP | CR0_NE);
+	asm volatile("fninit");
+
+	cpuid(1, NULL, NULL, NULL, &edx);
+	if ((edx & (CPUID1_EDX_FXSR | CPUID1_EDX_SSE | CPUID1_EDX_SSE2))
+	    != (CPUID1_EDX_FXSR | CPUID1_EDX_SSE | CPUID1_EDX_SSE2))
+		return;
+	lcr4(rcr4() | CR4_OSFXSR | CR4_OSXMMEXCPT);
+	fpu_sse2 = 1;
+
+	sse2_copy_min = SSE2_COPY_MIN;
+	sse2_set_min = SSE2_SET_MIN;
+	sse2_cmp_min = SSE2_CMP_MIN;
+}
+
+void
+kfpu_begin(struct Kfpu *kf)
+{
+	kf->eflags = read_eflags();
+	asm volatile("cli" ::: "memory");
+	kf->cr0 = rcr0();
+	if (kf->cr0 & CR0_TS)
+		asm volatile("clts");
+	asm volatile("movdqu %%xmm0, 0(%0)\n\t"
+		     "movdqu %%xmm1, 16(%0)\n\t"
+		     "movdqu %%xmm2, 32(%0)\n\t"
+		     "movdqu %%xmm3, 48(%0)"
+		     : : "r" (kf->xmm) : "memory");
+}
+
+void
+kfpu_end(struct Kfpu *kf)
+{
+	asm volatile("movdqu 0(%0), %%xmm0\n\t"
+		     "movdqu 16(%0), %%xmm1\n\t"
+		     "movdqu 32(%0), %%xmm2\n\t"
+		     "movdqu 48(%0), %%xmm3"
+		     : : "r" (kf->xmm) : "memory");
+	if (kf->cr0 & CR0_TS)
+		lcr0(kf->cr0);
+	write_eflags(kf->eflags);
+}
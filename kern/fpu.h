@@ -0,0 +1,44 @@
+#ifndef JOS_KERN_FPU_H
+#define JOS_KERN_FPU_H
+#ifndef JOS_KERNEL
+# error "This is a JOS kernel header; user programs should not #include it"
+#endif
+
+#include <inc/types.h>
+
+// Kernel code that wants SSE registers brackets their use with
+//
+//	struct Kfpu kf;
+//	kfpu_begin(&kf);
+//	... use %xmm0 through %xmm3 only ...
+//	kfpu_end(&kf);
+//
+// kfpu_begin turns interrupts off, clears CR0_TS if it was set (so a
+// lazily switched FPU does not fault) and saves the registers the
+// section may use in kf; kfpu_end puts all of that back.  So whatever
+// FPU state was live, a user environment's included, comes out intact,
+// and sections do not nest.  Only use these once fpu_init has found
+// SSE2 (fpu_sse2).
+
+#define KFPU_NXMM	4
+
+struct Kfpu {
+	uint8_t xmm[KFPU_NXMM][16];
+	uint32_t cr0;
+	uint32_t eflags;
+};
+
+extern bool fpu_sse2;
+
+void fpu_init(void);
+void kfpu_begin(struct Kfpu *kf);
+void kfpu_end(struct Kfpu *kf);
+
+// lib/string.c: memmove/memcpy, memset and memcmp switch to SSE2 at
+// these sizes.  They start out of reach, and fpu_init sets them if the
+// CPU has SSE2; the monitor's 'membench' measures where they belong.
+extern size_t sse2_copy_min;
+extern size_t sse2_set_min;
+extern size_t sse2_cmp_min;
+
+#endif	// !JOS_KERN_FPU_H
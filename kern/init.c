@@ -3,9 +3,17 @@
 #include <inc/stdio.h>
 #include <inc/string.h>
 #include <inc/assert.h>
+#include <inc/memlayout.h>
+#include <inc/bootinfo.h>
+#include <inc/multiboot.h>
+#include <inc/x86.h>
 
 #include <kern/monitor.h>
 #include <kern/console.h>
+#include <kern/trap.h>
+#include <kern/picirq.h>
+#include <kern/cpu.h>
+#include <kern/fpu.h>
 
 // Test the stack backtrace function (lab 1 only)
 void
@@ -19,24 +27,114 @@ test_backtrace(int x)
 	cprintf("leaving test_backtrace %d\n", x);
 }
 
+// Our copy of the boot loader's struct Bootinfo (zero if there was none),
+// with the kernel's own boot timeline stamps filled in
+struct Bootinfo bootinfo;
+
+// Until mem_init builds the real page tables, entry_pgdir maps only
+// the physical memory below EARLYMEM, at KERNBASE.  Return the kernel
+// address of [pa, pa+len), or NULL if that is not all mapped.
+static void *
+mbaddr(physaddr_t pa, size_t len)
+{
+	if (pa + len < pa || pa + len > EARLYMEM)
+		return NULL;
+	return (void *) (pa + KERNBASE);
+}
+
+// Fill in bootinfo from the Multiboot information block at mbi_pa.
+// Whatever a Multiboot loader put beyond the mapped region is ignored.
+static void
+multiboot_bootinfo(physaddr_t mbi_pa)
+{
+	struct Mbinfo *mbi;
+	struct Mbmmap *mm;
+	struct Mbmod *mod;
+	uint8_t *p, *pend;
+	uint32_t i, n;
+
+	if (!(mbi = mbaddr(mbi_pa, sizeof(*mbi))))
+		return;
+
+	if (mbi->flags & MULTIBOOT_INFO_MEMORY) {
+		bootinfo.mem_lower = mbi->mem_lower;
+		bootinfo.mem_upper = mbi->mem_upper;
+		bootinfo.flags |= BOOTINFO_MEMORY;
+	}
+
+	if ((mbi->flags & MULTIBOOT_INFO_MMAP)
+	    && (p = mbaddr(mbi->mmap_addr, mbi->mmap_length))) {
+		pend = p + mbi->mmap_length;
+		for (n = 0; p + sizeof(*mm) <= pend && n < BOOTINFO_MAXMMAP;
+		     p += mm->size + 4, n++) {
+			mm = (struct Mbmmap *) p;
+			bootinfo.mmap[n].addr = mm->addr;
+			bootinfo.mmap[n].len = mm->len;
+			bootinfo.mmap[n].type = mm->type;
+		}
+		bootinfo.nmmap = n;
+		bootinfo.flags |= BOOTINFO_MMAP;
+	}
+
+	n = MIN(mbi->mods_count, BOOTINFO_MAXMODS);
+	if ((mbi->flags & MULTIBOOT_INFO_MODS)
+	    && (mod = mbaddr(mbi->mods_addr, n * sizeof(*mod)))) {
+		for (i = 0; i < n; i++) {
+			bootinfo.mods[i].start = mod[i].mod_start;
+			bootinfo.mods[i].end = mod[i].mod_end;
+			bootinfo.mods[i].cmdline = mod[i].string;
+		}
+		bootinfo.nmods = n;
+		bootinfo.flags |= BOOTINFO_MODS;
+	}
+}
+
 void
-i386_init(void)
+i386_init(uint32_t boot_magic, physaddr_t boot_info)
 {
 	extern char edata[], end[];
+	extern uint64_t entry_tsc;
+	struct Bootinfo *bi = NULL;
+
+	// Our boot loader passes a struct Bootinfo (see inc/bootinfo.h);
+	// a Multiboot loader passes a struct Mbinfo (inc/multiboot.h).
+	if (boot_magic == BOOTINFO_MAGIC)
+		bi = (struct Bootinfo *) (boot_info + KERNBASE);
 
 	// Before doing anything else, complete the ELF loading process.
-	// Clear the uninitialized global data (BSS) section of our program.
+	// Clear the uninitialized global data (BSS) section of our program,
+	// unless the boot loader has already done so.
 	// This ensures that all static/global variables start out zero.
-	memset(edata, 0, end - edata);
+	if (!bi || !(bi->flags & BOOTINFO_BSSCLEAR))
+		memset(edata, 0, end - edata);
+	if (bi)
+		bootinfo = *bi;
+	else if (boot_magic == MULTIBOOT_BOOTLOADER_MAGIC)
+		multiboot_bootinfo(boot_info);
+	bootinfo.tsc[BOOTTS_ENTRY] = entry_tsc;
+	bootinfo.tsc[BOOTTS_BSS] = read_tsc();
+
+	// Find out which CPU this is, once, for cpunum().
+	cpu_init();
+
+	// Let lib/string.c use SSE2 for large operations, if there is any.
+	fpu_init();
 
 	// Initialize the console.
 	// Can't call cprintf until after we do this!
 	cons_init();
+	bootinfo.tsc[BOOTTS_CONS] = read_tsc();
+
+	// Take device interrupts, so the console can run from them.
+	trap_init();
+	pic_init();
+	asm volatile("sti");
 
 	cprintf("6828 decimal is %o octal!\n", 6828);
 
 	// Test the stack backtrace function (lab 1 only)
 	test_backtrace(5);
+	bootinfo.tsc[BOOTTS_INIT] = read_tsc();
 
 	// Drop into the kernel monitor.
 	while (1)
@@ -71,6 +169,7 @@ _panic(const char *file, int line, const char *fmt,...)
 	vcprintf(fmt, ap);
 	cprintf("\n");
 	va_end(ap);
+	cons_flush();
 
 dead:
 	/* break into the kernel monitor */
@@ -0,0 +1,71 @@
+/* See COPYRIGHT for copyright information. */
+
+#include <inc/stdio.h>
+#include <inc/stdarg.h>
+#include <inc/string.h>
+#include <inc/x86.h>
+
+#include <kern/ktrace.h>
+#include <kern/tsc.h>
+
+// The newest events overwrite the oldest ones
+struct Ktracering ktrace_ring;
+
+void
+ktrace_log(const char *fmt, int nargs, ...)
+{
+	struct Ktrace *ev;
+	uint32_t eflags;
+	va_list ap;
+	int i;
+
+	if (nargs > KTRACE_MAXARGS)
+		nargs = KTRACE_MAXARGS;
+	eflags = read_eflags();
+	asm volatile("cli" ::: "memory");
+	ev = &ktrace_ring.ev[ktrace_ring.wpos++ % NKTRACE];
+	ev->tsc = read_tsc();
+	ev->fmt = fmt;
+	ev->nargs = nargs;
+	va_start(ap, nargs);
+	for (i = 0; i < nargs; i++)
+		ev->args[i] = va_arg(ap, uint32_t);
+	va_end(ap);
+	write_eflags(eflags);
+}
+
+// Print the last n recorded events (all of them if n <= 0), oldest
+// first, with their time since the first one printed.
+void
+ktrace_print(int n)
+{
+	struct Ktrace ev;
+	uint32_t i, wpos;
+	uint64_t hz, t0 = 0;
+	int first = 1;
+
+	wpos = ktrace_ring.wpos;
+	if (n <= 0 || n > NKTRACE)
+		n = NKTRACE;
+	if ((uint32_t) n > wpos)
+		n = wpos;
+
+	hz = tsc_freq();
+	for (i = wpos - n; i != wpos; i++) {
+		ev = ktrace_ring.ev[i % NKTRACE];
+		if (!ev.fmt)
+			continue;
+		if (first)
+			t0 = ev.tsc;
+		first = 0;
+		cprintf("%10llu.%06llu ", (ev.tsc - t0) / hz,
+			(ev.tsc - t0) % hz * 1000000 / hz);
+		// On the i386, a va_list is a pointer to the arguments
+		// as they lie on the stack: one 32-bit word apiece.
+		vcprintf(ev.fmt, (va_list) ev.args);
+		if (ev.fmt[0] && ev.fmt[strlen(ev.fmt) - 1] != '\n')
+			cprintf("\n");
+	}
+	if (wpos > NKTRACE)
+		cprintf("(%u older events lost)\n", wpos - NKTRACE);
+}
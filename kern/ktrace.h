@@ -0,0 +1,67 @@
+#ifndef JOS_KERN_KTRACE_H
+#define JOS_KERN_KTRACE_H
+#ifndef JOS_KERNEL
+# error "This is a JOS kernel header; user programs should not #include it"
+#endif
+
+#include <inc/types.h>
+
+// ktrace(fmt, ...) records an event for later, cheaply: the format
+// string's address, the time stamp counter and up to KTRACE_MAXARGS
+// 32-bit arguments go into a ring, and formatting waits until someone
+// looks (the monitor's 'ktrace' command, or the ktrace-decode script
+// on a dump of the ring).  So the format and any %s argument must be
+// strings that stay put.
+
+#define KTRACE_MAXARGS	6
+#define NKTRACE		1024		// events in the ring
+
+struct Ktrace {
+	uint64_t tsc;
+	const char *fmt;		// NULL if the slot was never used
+	uint32_t nargs;
+	uint32_t args[KTRACE_MAXARGS];
+};
+
+struct Ktracering {
+	uint32_t wpos;			// events ever recorded
+	uint32_t reserved;
+	struct Ktrace ev[NKTRACE];
+};
+
+extern struct Ktracering ktrace_ring;
+
+void ktrace_log(const char *fmt, int nargs, ...);
+void ktrace_print(int n);
+
+// ktrace's arguments are checked at compile time: each must fit in a
+// 32-bit slot (pass a 64-bit value as two uint32_t arguments, low half
+// first, and %llx still prints it), and there may be at most
+// KTRACE_MAXARGS.
+// Up to 12 arguments are caught; ktrace_log drops any further ones.
+#define ktrace(fmt, ...) \
+	ktrace_log(fmt, KTRACE_NARGS(__VA_ARGS__) + \
+		   KTRACE_ARGS32(__VA_ARGS__), ##__VA_ARGS__)
+
+// 0, or a compile error (a negative array size) if cond is true
+#define KTRACE_ERROR(cond)	(sizeof(char[1 - 2 * !!(cond)]) - 1)
+
+// The number of arguments, 0 to KTRACE_MAXARGS
+#define KTRACE_NARGS(...) \
+	KTRACE_NARGS_(_, ##__VA_ARGS__, KTRACE_TOOMANY, KTRACE_TOOMANY, \
+		      KTRACE_TOOMANY, KTRACE_TOOMANY, KTRACE_TOOMANY, \
+		      KTRACE_TOOMANY, 6, 5, 4, 3, 2, 1, 0)
+#define KTRACE_NARGS_(_0, _1, _2, _3, _4, _5, _6, _7, _8, _9, _10, \
+		      _11, _12, n, ...) n
+#define KTRACE_TOOMANY		KTRACE_ERROR(1)
+
+// 0 if none of the (first KTRACE_MAXARGS) arguments is wider than 32
+// bits.  "+ 0" turns arrays (string literals) into pointers.
+#define KTRACE_ARGS32(...) \
+	KTRACE_ARGS32_(0, ##__VA_ARGS__, 0, 0, 0, 0, 0, 0)
+#define KTRACE_ARGS32_(_0, _1, _2, _3, _4, _5, _6, ...) \
+	(KTRACE_ARG32(_1) + KTRACE_ARG32(_2) + KTRACE_ARG32(_3) + \
+	 KTRACE_ARG32(_4) + KTRACE_ARG32(_5) + KTRACE_ARG32(_6))
+#define KTRACE_ARG32(x)	KTRACE_ERROR(sizeof((x) + 0) > sizeof(uint32_t))
+
+#endif	// !JOS_KERN_KTRACE_H
@@ -6,10 +6,14 @@
 #include <inc/memlayout.h>
 #include <inc/assert.h>
 #include <inc/x86.h>
+#include <inc/bootinfo.h>
 
 #include <kern/console.h>
 #include <kern/monitor.h>
 #include <kern/kdebug.h>
+#include <kern/tsc.h>
+#include <kern/ktrace.h>
+#include <kern/fpu.h>
 
 #define CMDBUF_SIZE	80	// enough for one VGA text line
 
@@ -25,6 +29,11 @@ static struct Command commands[] = {
 	{ "help", "Display this list of commands", mon_help },
 	{ "kerninfo", "Display information about the kernel", mon_kerninfo },
 	{ "backtrace", "Display a backtrace of the function stack", mon_backtrace },
+	{ "boottime", "Display where the time to boot went", mon_boottime },
+	{ "console", "List console devices, or turn one on or off", mon_console },
+	{ "consbench", "Time console output through each device", mon_consbench },
+	{ "ktrace", "Display the last [n] trace events", mon_ktrace },
+	{ "membench", "Time memcpy/memset/memcmp with and without SSE2", mon_membench },
 };
 
 /***** Implementations of basic kernel monitor commands *****/
@@ -43,6 +52,9 @@ int
 mon_kerninfo(int argc, char **argv, struct Trapframe *tf)
 {
 	extern char _start[], entry[], etext[], edata[], end[];
+	extern struct Bootinfo bootinfo;
+	struct Bootmmap *mm;
+	struct Bootmod *mod;
 
 	cprintf("Special kernel symbols:\n");
 	cprintf("  _start                  %08x (phys)\n", _start);
@@ -52,6 +64,19 @@ mon_kerninfo(int argc, char **argv, struct Trapframe *tf)
 	cprintf("  end    %08x (virt)  %08x (phys)\n", end, end - KERNBASE);
 	cprintf("Kernel executable memory footprint: %dKB\n",
 		ROUNDUP(end - entry, 1024) / 1024);
+
+	// What a Multiboot loader told us about the machine
+	if (bootinfo.flags & BOOTINFO_MEMORY)
+		cprintf("Memory: %dKB base, %dKB extended\n",
+			bootinfo.mem_lower, bootinfo.mem_upper);
+	if (bootinfo.flags & BOOTINFO_MMAP)
+		for (mm = bootinfo.mmap; mm < bootinfo.mmap + bootinfo.nmmap; mm++)
+			cprintf("  %016llx-%016llx %s\n", mm->addr,
+				mm->addr + mm->len - 1,
+				mm->type == 1 ? "available" : "reserved");
+	if (bootinfo.flags & BOOTINFO_MODS)
+		for (mod = bootinfo.mods; mod < bootinfo.mods + bootinfo.nmods; mod++)
+			cprintf("Module %08x-%08x\n", mod->start, mod->end);
 	return 0;
 }
 
@@ -64,8 +89,8 @@ mon_backtrace(int argc, char **argv, struct Trapframe *tf)
 	ptr_ebp = (uint32_t*)ebp;
     cprintf("Stack backtrace:\n");
     while (ebp != 0 && debuginfo_eip(ptr_ebp[1], &info) == 0) {
-        cprintf(" ebp %x  eip %x  args %08x %08x %08x %08x %08x\n", ebp, ptr_ebp[1], ptr_ebp[2], ptr_ebp[3], ptr_ebp[4], ptr_ebp[5], ptr_ebp[6]);
-        cprintf("     %s:%d: %.*s+%d\n", info.eip_file, info.eip_line, info.eip_fn_namelen, info.eip_fn_name, ptr_ebp[1] - info.eip_fn_addr);
+        CPRINTF_STATIC(" ebp %x  eip %x  args %08x %08x %08x %08x %08x\n", ebp, ptr_ebp[1], ptr_ebp[2], ptr_ebp[3], ptr_ebp[4], ptr_ebp[5], ptr_ebp[6]);
+        CPRINTF_STATIC("     %s:%d: %.*s+%d\n", info.eip_file, info.eip_line, info.eip_fn_namelen, info.eip_fn_name, ptr_ebp[1] - info.eip_fn_addr);
 		ebp = *ptr_ebp;
 		ptr_ebp = (uint32_t*)ebp;
     }
@@ -74,6 +99,283 @@ mon_backtrace(int argc, char **argv, struct Trapframe *tf)
 }
 
 
+int
+mon_boottime(int argc, char **argv, struct Trapframe *tf)
+{
+	// Each phase ends at the stamp of the same index
+	static const char * const phases[NBOOTTS] = {
+		[BOOTTS_LOADER_READ]	"boot sector setup",
+		[BOOTTS_LOADER_DONE]	"read loader",
+		[BOOTTS_KERN_READ]	"loader setup",
+		[BOOTTS_KERN_DONE]	"load kernel",
+		[BOOTTS_ENTRY]		"enter kernel",
+		[BOOTTS_BSS]		"kernel BSS/boot info",
+		[BOOTTS_CONS]		"cons_init",
+		[BOOTTS_INIT]		"init tests",
+	};
+	extern struct Bootinfo bootinfo;
+	uint64_t *ts = bootinfo.tsc;
+	uint64_t hz, d;
+	int i, first = -1, last = -1;
+
+	hz = tsc_freq();
+	cprintf("TSC %llu.%03llu MHz\n", hz / 1000000, hz / 1000 % 1000);
+	cprintf("%-22s %12s %10s\n", "phase", "cycles", "us");
+	for (i = 0; i < NBOOTTS; i++) {
+		if (!ts[i])
+			continue;
+		if (last >= 0) {
+			d = ts[i] - ts[last];
+			cprintf("%-22s %12llu %10llu\n", phases[i], d, d * 1000000 / hz);
+		}
+		if (first < 0)
+			first = i;
+		last = i;
+	}
+	if (first < 0 || first == last) {
+		cprintf("No boot timeline recorded\n");
+		return 0;
+	}
+	d = ts[last] - ts[first];
+	cprintf("%-22s %12llu %10llu\n", "total", d, d * 1000000 / hz);
+	return 0;
+}
+
+int
+mon_console(int argc, char **argv, struct Trapframe *tf)
+{
+	struct Conssink *sink;
+	int r;
+
+	if (argc == 3 && (strcmp(argv[2], "on") == 0 || strcmp(argv[2], "off") == 0)) {
+		if ((r = cons_sink_enable(argv[1], argv[2][1] == 'n')) < 0)
+			cprintf("console: can't turn %s %s: %e\n", argv[1], argv[2], r);
+		return 0;
+	} else if (argc != 1) {
+		cprintf("Usage: console [device on|off]\n");
+		return 0;
+	}
+
+	for (sink = cons_sinks; sink < cons_sinks + ncons_sinks; sink++)
+		cprintf("  %-8s %-8s %s\n", sink->name,
+			sink->present ? "present" : "absent",
+			sink->enabled ? "on" : "off");
+	cprintf("Input: %u dropped, %u serial overruns, %u serial throttles\n",
+		cons_stats.in_dropped, cons_stats.serial_overruns,
+		cons_stats.serial_throttles);
+	return 0;
+}
+
+// The most bytes consbench sends per run: over a minute at 9600 baud
+#define CONSBENCH_MAX	(64 * 1024)
+
+// One consbench run: cycles taken and where the waiting went
+struct Benchrun {
+	const char *name;
+	uint64_t cycles;
+	struct Consprof prof;
+};
+
+// Send n bytes of text lines to one device, or through cputchar to
+// all enabled ones if sink is NULL, and wait until it is all out.
+static void
+consbench_run(struct Benchrun *run, struct Conssink *sink, uint32_t n)
+{
+	static char line[CRT_COLS];
+	uint32_t i, j, m;
+	uint64_t t0;
+
+	for (i = 0; i < sizeof(line) - 1; i++)
+		line[i] = ' ' + i % ('~' - ' ' + 1);
+	line[sizeof(line) - 1] = '\n';
+
+	cons_flush();
+	memset(&cons_prof, 0, sizeof(cons_prof));
+	cons_prof.on = 1;
+	t0 = read_tsc();
+	for (i = 0; i < n; i += m) {
+		m = MIN(n - i, (uint32_t) sizeof(line));
+		if (sink)
+			sink->write(line, m);
+		else
+			for (j = 0; j < m; j++)
+				cputchar(line[j]);
+	}
+	if (!sink)
+		cons_flush();
+	else if (sink->flush)
+		sink->flush();
+	run->cycles = read_tsc() - t0;
+	cons_prof.on = 0;
+	run->prof = cons_prof;
+	run->name = sink ? sink->name : "cputchar";
+}
+
+int
+mon_consbench(int argc, char **argv, struct Trapframe *tf)
+{
+	struct Benchrun runs[8], *run;
+	struct Conssink *sink;
+	long arg = 4096;
+	uint32_t n;
+	uint64_t hz, c;
+	int nruns = 0;
+
+	if (argc == 2)
+		arg = strtol(argv[1], NULL, 0);
+	if (argc > 2 || arg <= 0 || arg > CONSBENCH_MAX) {
+		cprintf("Usage: consbench [bytes], at most %d bytes\n",
+			CONSBENCH_MAX);
+		return 0;
+	}
+	n = arg;
+
+	// Each present device on its own, then the whole console
+	assert(ncons_sinks < ARRAY_SIZE(runs));
+	hz = tsc_freq();
+	for (sink = cons_sinks; sink < cons_sinks + ncons_sinks; sink++)
+		if (sink->present)
+			consbench_run(&runs[nruns++], sink, n);
+	consbench_run(&runs[nruns++], NULL, n);
+
+	cprintf("%u bytes per run, TSC %llu MHz\n", n, hz / 1000000);
+	cprintf("%-8s %10s %10s %8s %16s %16s\n", "device", "bytes/s",
+		"cycles", "cyc/char", "delay() us (n)", "LSR poll us (n)");
+	for (run = runs; run < runs + nruns; run++) {
+		c = run->cycles ? run->cycles : 1;
+		cprintf("%-8s %10llu %10llu %8llu %9llu %6u %9llu %6u\n",
+			run->name, n * hz / c, run->cycles, run->cycles / n,
+			run->prof.delay_cycles * 1000000 / hz, run->prof.delays,
+			run->prof.lsr_cycles * 1000000 / hz, run->prof.lsr_polls);
+	}
+	return 0;
+}
+
+
+int
+mon_ktrace(int argc, char **argv, struct Trapframe *tf)
+{
+	if (argc > 2) {
+		cprintf("Usage: ktrace [n]\n");
+		return 0;
+	}
+	ktrace_print(argc == 2 ? strtol(argv[1], NULL, 0) : 0);
+	return 0;
+}
+
+// membench sizes: MEMBENCH_MIN, doubling, up to MEMBENCH_MAX bytes
+#define MEMBENCH_MIN	128
+#define MEMBENCH_MAX	16384
+#define MEMBENCH_NSIZES	8
+#define MEMBENCH_REPS	8
+
+enum { MB_MEMCPY, MB_MEMSET, MB_MEMCMP, MB_NOPS };
+
+static const char *membench_names[MB_NOPS] = { "memcpy", "memset", "memcmp" };
+static size_t *membench_mins[MB_NOPS] = {
+	&sse2_copy_min, &sse2_set_min, &sse2_cmp_min
+};
+
+// The fewest cycles, over MEMBENCH_REPS runs, that one op takes on n
+// bytes.  The buffers start on a page, but the source is offset, so
+// SSE2 sees the misaligned loads it would in real use.
+static uint64_t
+membench_run(int op, size_t n)
+{
+	static uint8_t src[MEMBENCH_MAX + 16] __attribute__((aligned(PGSIZE)));
+	static uint8_t dst[MEMBENCH_MAX] __attribute__((aligned(PGSIZE)));
+	static volatile int sink;
+	uint64_t t0, t, best = ~0ULL;
+	int i;
+
+	for (i = 0; i < MEMBENCH_REPS; i++) {
+		if (op == MB_MEMCMP)
+			memcpy(dst, src + 4, n);
+		t0 = read_tsc();
+		if (op == MB_MEMCPY)
+			memcpy(dst, src + 4, n);
+		else if (op == MB_MEMSET)
+			memset(dst, i, n);
+		else
+			sink = memcmp(dst, src + 4, n);
+		t = read_tsc() - t0;
+		best = MIN(best, t);
+	}
+	return best;
+}
+
+static void
+membench_size(size_t n)
+{
+	if (n == (size_t) -1)
+		cprintf("(never)");
+	else
+		cprintf("%u", n);
+}
+
+int
+mon_membench(int argc, char **argv, struct Trapframe *tf)
+{
+	uint64_t cyc[MB_NOPS][MEMBENCH_NSIZES][2];
+	size_t saved[MB_NOPS], n, min;
+	int op, i, tune;
+
+	tune = argc == 2 && strcmp(argv[1], "tune") == 0;
+	if (argc > 2 || (argc == 2 && !tune)) {
+		cprintf("Usage: membench [tune]\n");
+		return 0;
+	}
+	if (!fpu_sse2) {
+		cprintf("No SSE2 on this CPU\n");
+		return 0;
+	}
+
+	// Each op at each size, first with the string instructions,
+	// then with SSE2, by moving its threshold out of reach and back
+	for (op = 0; op < MB_NOPS; op++) {
+		saved[op] = *membench_mins[op];
+		for (i = 0, n = MEMBENCH_MIN; i < MEMBENCH_NSIZES; i++, n *= 2) {
+			*membench_mins[op] = (size_t) -1;
+			cyc[op][i][0] = membench_run(op, n);
+			*membench_mins[op] = 0;
+			cyc[op][i][1] = membench_run(op, n);
+		}
+		*membench_mins[op] = saved[op];
+	}
+
+	cprintf("Cycles, string instructions / SSE2\n");
+	cprintf("%6s", "bytes");
+	for (op = 0; op < MB_NOPS; op++)
+		cprintf(" %17s", membench_names[op]);
+	cprintf("\n");
+	for (i = 0, n = MEMBENCH_MIN; i < MEMBENCH_NSIZES; i++, n *= 2) {
+		cprintf("%6u", n);
+		for (op = 0; op < MB_NOPS; op++)
+			cprintf(" %8llu %8llu", cyc[op][i][0], cyc[op][i][1]);
+		cprintf("\n");
+	}
+
+	// The smallest size from which SSE2 wins all the way up.  If it
+	// does not even win at MEMBENCH_MAX, keep it out of reach.
+	for (op = 0; op < MB_NOPS; op++) {
+		min = (size_t) -1;
+		for (i = MEMBENCH_NSIZES - 1; i >= 0; i--) {
+			if (cyc[op][i][1] >= cyc[op][i][0])
+				break;
+			min = MEMBENCH_MIN << i;
+		}
+		if (tune)
+			*membench_mins[op] = min;
+		cprintf("%s: SSE2 wins from ", membench_names[op]);
+		membench_size(min);
+		cprintf(", in use from ");
+		membench_size(*membench_mins[op]);
+		cprintf("\n");
+	}
+	if (!tune)
+		cprintf("'membench tune' sets these\n");
+	return 0;
+}
 
 /***** Kernel monitor command interpreter *****/
 
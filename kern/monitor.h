@@ -15,5 +15,10 @@ void monitor(struct Trapframe *tf);
 int mon_help(int argc, char **argv, struct Trapframe *tf);
 int mon_kerninfo(int argc, char **argv, struct Trapframe *tf);
 int mon_backtrace(int argc, char **argv, struct Trapframe *tf);
+int mon_boottime(int argc, char **argv, struct Trapframe *tf);
+int mon_console(int argc, char **argv, struct Trapframe *tf);
+int mon_consbench(int argc, char **argv, struct Trapframe *tf);
+int mon_ktrace(int argc, char **argv, struct Trapframe *tf);
+int mon_membench(int argc, char **argv, struct Trapframe *tf);
 
 #endif	// !JOS_KERN_MONITOR_H
@@ -1,27 +1,180 @@
 // Simple implementation of cprintf console output for the kernel,
-// based on printfmt() and the kernel console's cputchar().
+// based on printfmt() and the kernel console's cons_write().
+//
+// Each CPU formats its output into a log ring of its own, which only
+// it writes and which needs no lock.  Whichever CPU gets cprintf_lock
+// then drains all the rings onto the console, oldest record first by
+// time stamp.  A CPU that finds the lock taken leaves its output for
+// the holder, which looks again after letting go of the lock.
 
 #include <inc/types.h>
 #include <inc/stdio.h>
 #include <inc/stdarg.h>
+#include <inc/string.h>
+#include <inc/x86.h>
 
+#include <kern/cpu.h>
+#include <kern/console.h>
 
+#define NLOGREC		32	// records per CPU ring
+#define LOGRECSIZE	120	// characters per record
+
+// One piece of output: a cprintf call's, or a part of it if it
+// takes more than one record.
+struct Logrec {
+	uint64_t tsc;			// when the cprintf started
+	uint32_t len;
+	char buf[LOGRECSIZE];
+};
+
+// rpos and wpos count records and never wrap; only the CPU that owns
+// the ring moves wpos, and only the lock holder moves rpos.
+static struct Cpulog {
+	struct Logrec rec[NLOGREC];
+	volatile uint32_t rpos;
+	volatile uint32_t wpos;
+} cpulog[NCPU];
+
+static volatile uint32_t cprintf_lock;
+static volatile int cprintf_cpu = -1;	// CPU holding cprintf_lock
+
+// The state of one vcprintf, as it fills records
+struct Logput {
+	struct Cpulog *log;
+	struct Logrec *rec;		// NULL while dropping output
+	int cnt;
+};
+
+static void cprintf_drain(void);
+
+// Hand the current record to the drainer
+static void
+log_publish(struct Logput *lp)
+{
+	if (!lp->rec || !lp->rec->len)
+		return;
+	asm volatile("" ::: "memory");
+	lp->log->wpos++;
+}
+
+// Make lp->rec the next free record, draining to make room for it.
+// If this CPU is itself the drainer, we interrupted it, and waiting
+// for it would wait forever: drop the output instead.
 static void
-putch(int ch, int *cnt)
+log_next(struct Logput *lp, uint64_t tsc)
 {
-	cputchar(ch);
-	// 向控制台输出一个字符
-	*cnt++;
-	// 指向最近输出字符的指针
+	while (lp->log->wpos - lp->log->rpos == NLOGREC) {
+		if (cprintf_cpu == lp->log - cpulog) {
+			lp->rec = NULL;
+			return;
+		}
+		cprintf_drain();
+	}
+	lp->rec = &lp->log->rec[lp->log->wpos % NLOGREC];
+	lp->rec->tsc = tsc;
+	lp->rec->len = 0;
+}
+
+static void
+putch(int ch, struct Logput *lp)
+{
+	if (lp->rec && lp->rec->len == LOGRECSIZE) {
+		log_publish(lp);
+		log_next(lp, lp->rec->tsc);
+	}
+	if (lp->rec)
+		lp->rec->buf[lp->rec->len++] = ch;
+	lp->cnt++;
+}
+
+static void
+putstr(const char *s, size_t len, struct Logput *lp)
+{
+	size_t n;
+
+	lp->cnt += len;
+	while (len > 0 && lp->rec) {
+		if (lp->rec->len == LOGRECSIZE) {
+			log_publish(lp);
+			log_next(lp, lp->rec->tsc);
+			continue;
+		}
+		n = MIN(len, LOGRECSIZE - lp->rec->len);
+		memcpy(lp->rec->buf + lp->rec->len, s, n);
+		lp->rec->len += n;
+		s += n;
+		len -= n;
+	}
+}
+
+static const struct Printops logops = { (void*) putch, (void*) putstr };
+
+// Write all records in the rings to the console, oldest first, if no
+// other CPU is already doing it.
+static void
+cprintf_drain(void)
+{
+	struct Cpulog *log, *oldest;
+	struct Logrec *rec;
+
+	do {
+		if (xchg(&cprintf_lock, 1) != 0)
+			return;
+		cprintf_cpu = cpunum();
+		for (;;) {
+			oldest = NULL;
+			for (log = cpulog; log < cpulog + NCPU; log++)
+				if (log->rpos != log->wpos
+				    && (!oldest || log->rec[log->rpos % NLOGREC].tsc
+					< oldest->rec[oldest->rpos % NLOGREC].tsc))
+					oldest = log;
+			if (!oldest)
+				break;
+			asm volatile("" ::: "memory");
+			rec = &oldest->rec[oldest->rpos % NLOGREC];
+			cons_write(rec->buf, rec->len);
+			asm volatile("" ::: "memory");
+			oldest->rpos++;
+		}
+		cprintf_cpu = -1;
+		xchg(&cprintf_lock, 0);
+
+		// Catch output that came in as we let go of the lock
+		for (log = cpulog; log < cpulog + NCPU; log++)
+			if (log->rpos != log->wpos)
+				break;
+	} while (log < cpulog + NCPU);
+}
+
+// Format into this CPU's ring, through fc if not NULL
+static int
+logprintf(struct Fmtcache *fc, const char *fmt, va_list ap)
+{
+	struct Logput lp;
+	uint32_t eflags;
+
+	// Nothing else may write this CPU's ring until we are done,
+	// interrupt handlers included.
+	eflags = read_eflags();
+	asm volatile("cli" ::: "memory");
+	lp.log = &cpulog[cpunum()];
+	lp.cnt = 0;
+	log_next(&lp, read_tsc());
+	if (fc)
+		vprintfmt_cached(&logops, &lp, fc, fmt, ap);
+	else
+		vprintfmt_ops(&logops, &lp, fmt, ap);
+	log_publish(&lp);
+	write_eflags(eflags);
+
+	cprintf_drain();
+	return lp.cnt;
 }
 
 int
 vcprintf(const char *fmt, va_list ap)
 {
-	int cnt = 0;
-	// 指定vprintfmt的字符输出函数putch()
-	vprintfmt((void*)putch, &cnt, fmt, ap);
-	return cnt;
+	return logprintf(NULL, fmt, ap);
 }
 
 int
@@ -37,3 +190,16 @@ cprintf(const char *fmt, ...)
 	return cnt;
 }
 
+// cprintf for CPRINTF_STATIC
+int
+cprintf_cached(struct Fmtcache *fc, const char *fmt, ...)
+{
+	va_list ap;
+	int cnt;
+
+	va_start(ap, fmt);
+	cnt = logprintf(fc, fmt, ap);
+	va_end(ap);
+
+	return cnt;
+}
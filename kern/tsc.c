@@ -0,0 +1,51 @@
+/* See COPYRIGHT for copyright information. */
+
+#include <inc/x86.h>
+
+#include <kern/tsc.h>
+
+// The 8254 PIT's channel 2 can be gated and its output read back
+// through port B of the keyboard controller, without involving the
+// interrupt controller.
+#define PIT_HZ		1193182
+#define PIT_CH2		0x42		// channel 2 counter
+#define PIT_MODE	0x43		// mode/command register
+#define PORTB		0x61
+#define   PORTB_GATE2	0x01		// channel 2 gate
+#define   PORTB_SPKR	0x02		// speaker data enable
+#define   PORTB_OUT2	0x20		// channel 2 output
+
+#define CALIB_MS	10		// length of the calibration interval
+
+static uint64_t tsc_hz;
+
+// Count TSC ticks across a CALIB_MS one-shot of PIT channel 2.
+// The result is cached, so only the first call takes any time.
+uint64_t
+tsc_freq(void)
+{
+	uint32_t latch = PIT_HZ / (1000 / CALIB_MS);
+	uint64_t t0, t1;
+	uint8_t portb;
+
+	if (tsc_hz)
+		return tsc_hz;
+
+	// Gate channel 2 on with the speaker off, then load a mode 0
+	// (interrupt on terminal count) countdown; OUT2 goes high when
+	// it reaches zero.
+	portb = inb(PORTB);
+	outb(PORTB, (portb & ~PORTB_SPKR) | PORTB_GATE2);
+	outb(PIT_MODE, 0xB0);		// channel 2, lo/hi byte, mode 0
+	outb(PIT_CH2, latch & 0xFF);
+	outb(PIT_CH2, latch >> 8);
+
+	t0 = read_tsc();
+	while (!(inb(PORTB) & PORTB_OUT2))
+		/* do nothing */;
+	t1 = read_tsc();
+	outb(PORTB, portb);
+
+	tsc_hz = (t1 - t0) * (1000 / CALIB_MS);
+	return tsc_hz;
+}
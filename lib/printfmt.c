@@ -28,26 +28,109 @@ static const char * const error_string[MAXERROR] =
 	[E_FAULT]	= "segmentation fault",
 };
 
+// Two-digit decimal strings for 00 through 99
+static const char digits100[200] =
+	"00010203040506070809" "10111213141516171819"
+	"20212223242526272829" "30313233343536373839"
+	"40414243444546474849" "50515253545556575859"
+	"60616263646566676869" "70717273747576777879"
+	"80818283848586878889" "90919293949596979899";
+
+// Divide *n by d in place and return the remainder, with two 32-bit
+// divides instead of a call to libgcc's 64-bit __udivdi3/__umoddi3.
+// Dividing the remainder of the high word first keeps the quotient of
+// the second divide within 32 bits.
+static inline uint32_t
+divrem64(unsigned long long *n, uint32_t d)
+{
+	uint32_t hi = *n >> 32, lo = *n, qhi, r;
+
+	qhi = hi / d;
+	asm("divl %4" : "=a" (lo), "=d" (r) : "a" (lo), "d" (hi % d), "rm" (d));
+	*n = (unsigned long long) qhi << 32 | lo;
+	return r;
+}
+
+// Output n characters at s, in one piece if the printer can take it
+static void
+emit(const struct Printops *ops, void *putdat, const char *s, size_t n)
+{
+	if (ops->putstr)
+		ops->putstr(s, n, putdat);
+	else
+		for (; n > 0; n--)
+			ops->putch(*s++, putdat);
+}
+
+// Output n copies of the pad character c
+static void
+emitpad(const struct Printops *ops, void *putdat, int c, int n)
+{
+	char pad[32];
+	int m;
+
+	if (n <= 0)
+		return;
+	memset(pad, c, MIN(n, (int) sizeof(pad)));
+	for (; n > 0; n -= m) {
+		m = MIN(n, (int) sizeof(pad));
+		emit(ops, putdat, pad, m);
+	}
+}
+
 /*
- * Print a number (base <= 16) in reverse order,
- * using specified putch function and associated pointer putdat.
- * 反向输出
+ * Print a number (base <= 16), right-justified in width characters
+ * padded on the left with padc, using the specified printer and
+ * associated pointer putdat.  The digits are generated backwards into
+ * a buffer on the stack, along with as much of the padding as fits.
  */
 static void
-printnum(void (*putch)(int, void*), void *putdat,
+printnum(const struct Printops *ops, void *putdat,
 	 unsigned long long num, unsigned base, int width, int padc)
 {
-	// first recursively print all preceding (more significant) digits
-	if (num >= base) {
-		printnum(putch, putdat, num / base, base, width - 1, padc);
+	char buf[64];			// 64 bits in octal is 22 digits
+	char *p = buf + sizeof(buf);
+	uint32_t n, r;
+	int shift;
+
+	if (base == 16 || base == 8) {
+		shift = (base == 16 ? 4 : 3);
+		do {
+			*--p = "0123456789abcdef"[num & (base - 1)];
+			num >>= shift;
+		} while (num);
+	} else if (base == 10) {
+		while (num >> 32) {
+			r = divrem64(&num, 100);
+			*--p = digits100[2 * r + 1];
+			*--p = digits100[2 * r];
+		}
+		for (n = num; n >= 100; n /= 100) {
+			r = n % 100;
+			*--p = digits100[2 * r + 1];
+			*--p = digits100[2 * r];
+		}
+		if (n >= 10) {
+			*--p = digits100[2 * n + 1];
+			*--p = digits100[2 * n];
+		} else
+			*--p = '0' + n;
 	} else {
-		// print any needed pad characters before first digit
-		while (--width > 0)
-			putch(padc, putdat);
+		do {
+			*--p = "0123456789abcdef"[divrem64(&num, base)];
+		} while (num);
+	}
+
+	// print any needed pad characters before first digit
+	width -= buf + sizeof(buf) - p;
+	if (width > p - buf) {
+		emitpad(ops, putdat, padc, width - (p - buf));
+		width = p - buf;
 	}
+	for (; width > 0; width--)
+		*--p = padc;
 
-	// then print this (the least significant) digit
-	putch("0123456789abcdef"[num % base], putdat);
+	emit(ops, putdat, p, buf + sizeof(buf) - p);
 }
 
 // Get an unsigned int of various possible sizes from a varargs list, depending on the lflag parameter.
@@ -89,172 +172,314 @@ void printfmt(void (*putch)(int, void*), void *putdat, const char *fmt, ...);
 void
 vprintfmt(void (*putch)(int, void*), void *putdat, const char *fmt, va_list ap)
 {
-	// putch 是简单的cputchar()，然后对已经输出的字符个数进行统计：
-	// putch 是控制台输出函数
-	// putdat 是输出最后一个字符的指针
-	register const char *p;
-	register int ch, err;
-	unsigned long long num;
-	int base, lflag, width, precision, altflag;
-	char padc;
+	struct Printops ops = { putch, NULL };
 
-	while (1) {
-		while ((ch = *(unsigned char *) fmt++) != '%') {
-			if (ch == '\0')
-				return;
-			putch(ch, putdat);
-			// 将 % 前面的全部输出到控制台
-			// 将 ch 输出到控制台, putdat 是指向记录输出的个数的指针
+	vprintfmt_ops(&ops, putdat, fmt, ap);
+}
+
+// Parse the %-escape sequence after the '%' at *fmtp into *spec and
+// advance *fmtp past it.  An unrecognized sequence parses as a '%'
+// conversion that leaves *fmtp just after the '%', so the rest of the
+// sequence prints literally.
+//
+// With ap, a '*' takes its value from the arguments right away.
+// Without it, spec->star records where the value will go; that only
+// works if nothing after the '*' could move it, else return -1.
+static int
+parse_spec(const char **fmtp, struct Fmtspec *spec, va_list *ap)
+{
+	const char *fmt = *fmtp;
+	int ch, width, precision;
+
+	// 处理一系列的 % 的过程
+	spec->padc = ' ';
+	spec->lflag = 0;
+	spec->altflag = 0;
+	// Alt 的 Flag
+	spec->star = FMTSTAR_NONE;
+	width = -1;
+	precision = -1;
+reswitch:
+	switch (ch = *(unsigned char *) fmt++) {
+
+	// flag to pad on the right
+	case '-':
+		spec->padc = '-';
+		goto reswitch;
+
+	// flag to pad with 0's instead of spaces
+	case '0':
+		spec->padc = '0';
+		goto reswitch;
+
+	// width field
+	case '1':
+	case '2':
+	case '3':
+	case '4':
+	case '5':
+	case '6':
+	case '7':
+	case '8':
+	case '9':
+		if (spec->star)
+			return -1;
+		for (precision = 0; ; ++fmt) {
+			precision = precision * 10 + ch - '0';
+			ch = *fmt;
+			if (ch < '0' || ch > '9')
+				break;
 		}
+		goto process_precision;
 
-		// Process a %-escape sequence
-		// 处理一系列的 % 的过程
-		padc = ' ';
-		width = -1;
-		precision = -1;
-		lflag = 0;
-		altflag = 0;
-		// Alt 的 Flag
-	reswitch:
-		switch (ch = *(unsigned char *) fmt++) {
-		
-		// flag to pad on the right
-		case '-':
-			padc = '-';
+	case '*':
+		if (spec->star)
+			return -1;
+		if (!ap) {
+			spec->star = (width < 0 ? FMTSTAR_WIDTH : FMTSTAR_PRECISION);
 			goto reswitch;
+		}
+		precision = va_arg(*ap, int);
+		goto process_precision;
+
+	case '.':
+		if (spec->star)
+			return -1;
+		if (width < 0)
+			width = 0;
+		goto reswitch;
+
+	case '#':
+		spec->altflag = 1;
+		goto reswitch;
+
+	process_precision:
+		if (width < 0)
+			width = precision, precision = -1;
+		goto reswitch;
+
+	// long flag (doubled for long long)
+	case 'l':
+		// long 类型flag ++
+		spec->lflag++;
+		goto reswitch;
+
+	// 上面这些都是一些没有意义的标志, 所以需要再读取一个字符标志
+	case 'c':
+	case 'e':
+	case 's':
+	case 'd':
+	case 'u':
+	case 'o':
+	case 'p':
+	case 'x':
+	case '%':
+		break;
+
+	// unrecognized escape sequence - just print it literally
+	default:
+		ch = '%';
+		fmt = *fmtp;
+		break;
+	}
 
-		// flag to pad with 0's instead of spaces
-		case '0':
-			padc = '0';
-			goto reswitch;
+	spec->conv = ch;
+	spec->width = width;
+	spec->precision = precision;
+	*fmtp = fmt;
+	return 0;
+}
 
-		// width field
-		case '1':
-		case '2':
-		case '3':
-		case '4':
-		case '5':
-		case '6':
-		case '7':
-		case '8':
-		case '9':
-			for (precision = 0; ; ++fmt) {
-				precision = precision * 10 + ch - '0';
-				ch = *fmt;
-				if (ch < '0' || ch > '9')
+// Print one conversion, taking its arguments from *ap
+static void
+emit_conv(const struct Printops *ops, void *putdat, const struct Fmtspec *spec, va_list *ap)
+{
+	const char *p;
+	unsigned long long num;
+	int ch, err, base, len;
+	int width = spec->width, precision = spec->precision;
+	char padc = spec->padc;
+
+	if (spec->star == FMTSTAR_WIDTH)
+		width = va_arg(*ap, int);
+	else if (spec->star == FMTSTAR_PRECISION)
+		precision = va_arg(*ap, int);
+
+	switch (spec->conv) {
+	// character
+	case 'c':
+		ops->putch(va_arg(*ap, int), putdat);
+		break;
+
+	// error message
+	case 'e':
+		err = va_arg(*ap, int);
+		if (err < 0)
+			err = -err;
+		if (err >= MAXERROR || (p = error_string[err]) == NULL) {
+			emit(ops, putdat, "error ", 6);
+			printnum(ops, putdat, err, 10, -1, ' ');
+		} else
+			emit(ops, putdat, p, strlen(p));
+		break;
+
+	// string
+	case 's':
+		if ((p = va_arg(*ap, char *)) == NULL)
+			p = "(null)";
+		len = strnlen(p, precision);
+		if (padc != '-')
+			emitpad(ops, putdat, padc, width - len);
+		else
+			width -= len;
+		// with altflag, a '?' for each unprintable character
+		while (len > 0) {
+			for (ch = 0; ch < len; ch++)
+				if (spec->altflag && (p[ch] < ' ' || p[ch] > '~'))
 					break;
-			}
-			goto process_precision;
-
-		case '*':
-			precision = va_arg(ap, int);
-			goto process_precision;
-
-		case '.':
-			if (width < 0)
-				width = 0;
-			goto reswitch;
+			if (ch == 0) {
+				ops->putch('?', putdat);
+				ch = 1;
+			} else
+				emit(ops, putdat, p, ch);
+			p += ch;
+			len -= ch;
+		}
+		if (padc == '-')
+			emitpad(ops, putdat, ' ', width);
+		break;
+
+	// (signed) decimal
+	case 'd':
+		num = getint(ap, spec->lflag);
+		if ((long long) num < 0) {
+			ops->putch('-', putdat);
+			num = -(long long) num;
+		}
+		base = 10;
+		goto number;
+
+	// unsigned decimal
+	case 'u':
+		num = getuint(ap, spec->lflag);
+		base = 10;
+		goto number;
+
+	// (unsigned) octal
+	case 'o':
+		num = getuint(ap, spec->lflag);
+		base = 8;
+		goto number;
+
+	// pointer
+	case 'p':
+		emit(ops, putdat, "0x", 2);
+		num = (unsigned long long)
+			(uintptr_t) va_arg(*ap, void *);
+		base = 16;
+		goto number;
+
+	// (unsigned) hexadecimal
+	case 'x':
+		num = getuint(ap, spec->lflag);
+		base = 16;
+	number:
+		printnum(ops, putdat, num, base, width, padc);
+		break;
+
+	// escaped '%' character, or an unrecognized escape sequence
+	case '%':
+		ops->putch('%', putdat);
+		break;
+	}
+}
 
-		case '#':
-			altflag = 1;
-			goto reswitch;
+// Like vprintfmt, but literal text, strings and padding go to
+// ops->putstr a run at a time, if there is one.
+void
+vprintfmt_ops(const struct Printops *ops, void *putdat, const char *fmt, va_list ap)
+{
+	// ops->putch 是简单的cputchar()，然后对已经输出的字符个数进行统计：
+	// ops->putch 是控制台输出函数
+	// putdat 是输出最后一个字符的指针
+	struct Fmtspec spec;
+	const char *p;
 
-		process_precision:
-			if (width < 0)
-				width = precision, precision = -1;
-			goto reswitch;
+	while (1) {
+		// 将 % 前面的全部输出到控制台
+		for (p = fmt; *fmt != '%' && *fmt != '\0'; fmt++)
+			/* do nothing */;
+		if (fmt > p)
+			emit(ops, putdat, p, fmt - p);
+		if (*fmt++ == '\0')
+			return;
 
-		// long flag (doubled for long long)
-		case 'l':
-			// long 类型flag ++
-			lflag++;
-			goto reswitch;
-		// 上面这些都是一些没有意义的标志, 所以需要再读取一个字符标志
-		// character
-		case 'c':
-			putch(va_arg(ap, int), putdat);
-			break;
+		// Process a %-escape sequence
+		parse_spec(&fmt, &spec, &ap);
+		emit_conv(ops, putdat, &spec, &ap);
+	}
+}
 
-		// error message
-		case 'e':
-			err = va_arg(ap, int);
-			if (err < 0)
-				err = -err;
-			if (err >= MAXERROR || (p = error_string[err]) == NULL)
-				printfmt(putch, putdat, "error %d", err);
-			else
-				printfmt(putch, putdat, "%s", p);
+// Parse fmt into fc's list of literal runs and conversions.  A format
+// that needs more than FMTCACHE_NOPS entries, or has a '*' that can't
+// be resolved ahead of time, gets fc->nops = -1 and is formatted by
+// vprintfmt_ops every time.
+static void
+fmtcache_parse(struct Fmtcache *fc, const char *fmt)
+{
+	const char *start = fmt, *p;
+	struct Fmtop *op;
+	int n;
+
+	for (n = 0; ; n++) {
+		if (n == FMTCACHE_NOPS)
+			goto uncacheable;
+		op = &fc->ops[n];
+		for (p = fmt; *fmt != '%' && *fmt != '\0'; fmt++)
+			/* do nothing */;
+		if (fmt - start > 0xFFFF)
+			goto uncacheable;
+		op->off = p - start;
+		op->len = fmt - p;
+		if (*fmt++ == '\0') {
+			op->spec.conv = 0;
 			break;
+		}
+		if (parse_spec(&fmt, &op->spec, NULL) < 0)
+			goto uncacheable;
+	}
 
-		// string
-		case 's':
-			if ((p = va_arg(ap, char *)) == NULL)
-				p = "(null)";
-			if (width > 0 && padc != '-')
-				for (width -= strnlen(p, precision); width > 0; width--)
-					putch(padc, putdat);
-			for (; (ch = *p++) != '\0' && (precision < 0 || --precision >= 0); width--)
-				if (altflag && (ch < ' ' || ch > '~'))
-					putch('?', putdat);
-				else
-					putch(ch, putdat);
-			for (; width > 0; width--)
-				putch(' ', putdat);
-			break;
+	// publish the list only once it is complete
+	asm volatile("" ::: "memory");
+	fc->nops = n + 1;
+	return;
 
-		// (signed) decimal
-		case 'd':
-			num = getint(&ap, lflag);
-			if ((long long) num < 0) {
-				putch('-', putdat);
-				num = -(long long) num;
-			}
-			base = 10;
-			goto number;
-
-		// unsigned decimal
-		case 'u':
-			num = getuint(&ap, lflag);
-			base = 10;
-			goto number;
-
-		// (unsigned) octal
-		case 'o':
-			// Replace this with your code.
-			num = getuint(&ap, lflag);
-			base = 8;
-			goto number;
-			break;
+uncacheable:
+	fc->nops = -1;
+}
 
-		// pointer
-		case 'p':
-			putch('0', putdat);
-			putch('x', putdat);
-			num = (unsigned long long)
-				(uintptr_t) va_arg(ap, void *);
-			base = 16;
-			goto number;
-
-		// (unsigned) hexadecimal
-		case 'x':
-			num = getuint(&ap, lflag);
-			base = 16;
-		number:
-			printnum(putch, putdat, num, base, width, padc);
-			break;
+// Like vprintfmt_ops, for a format that never changes: it is parsed
+// the first time into *fc (which must start out zeroed) and later
+// calls just walk the parsed list.
+void
+vprintfmt_cached(const struct Printops *ops, void *putdat, struct Fmtcache *fc,
+		 const char *fmt, va_list ap)
+{
+	const struct Fmtop *op;
 
-		// escaped '%' character
-		case '%':
-			putch(ch, putdat);
-			break;
+	if (fc->nops == 0)
+		fmtcache_parse(fc, fmt);
+	if (fc->nops < 0) {
+		vprintfmt_ops(ops, putdat, fmt, ap);
+		return;
+	}
 
-		// unrecognized escape sequence - just print it literally
-		default:
-			putch('%', putdat);
-			for (fmt--; fmt[-1] != '%'; fmt--)
-				/* do nothing */;
-			break;
-		}
+	for (op = fc->ops; ; op++) {
+		if (op->len)
+			emit(ops, putdat, fmt + op->off, op->len);
+		if (!op->spec.conv)
+			return;
+		emit_conv(ops, putdat, &op->spec, &ap);
 	}
 }
 
@@ -284,6 +509,20 @@ sprintputch(int ch, struct sprintbuf *b)
 		*b->buf++ = ch;
 }
 
+static void
+sprintputstr(const char *s, size_t len, struct sprintbuf *b)
+{
+	size_t n = MIN(len, (size_t) (b->ebuf - b->buf));
+
+	b->cnt += len;
+	memcpy(b->buf, s, n);
+	b->buf += n;
+}
+
+static const struct Printops sprintops = {
+	(void*) sprintputch, (void*) sprintputstr
+};
+
 int
 vsnprintf(char *buf, int n, const char *fmt, va_list ap)
 {
@@ -296,7 +535,7 @@ vsnprintf(char *buf, int n, const char *fmt, va_list ap)
 
 	// print the string to the buffer
 	// 这里的 sprintputch 函数不是输出到控制台, 而是一个缓冲区
-	vprintfmt((void*)sprintputch, &b, fmt, ap);
+	vprintfmt_ops(&sprintops, &b, fmt, ap);
 
 	// null terminate the buffer
 	*b.buf = '\0';
@@ -1,4 +1,5 @@
 // Basic string routines.  Not hardware optimized, but not shabby.
+// (Except memset and memmove, which use the string instructions.)
 
 #include <inc/string.h>
 
@@ -118,23 +119,163 @@ strfind(const char *s, char c)
 }
 
 #if ASM
+// The string instructions, forwards, on operands that may start
+// anywhere.  The registers are in-out operands because the
+// instructions consume them.  Each clears DF itself rather than trust
+// that nothing left it set.
+static inline void
+rep_stosb(void *d, int c, size_t n)
+{
+	asm volatile("cld; rep stosb" : "+D" (d), "+c" (n) : "a" (c)
+		     : "cc", "memory");
+}
+
+static inline void
+rep_stosl(void *d, uint32_t c, size_t n)
+{
+	asm volatile("cld; rep stosl" : "+D" (d), "+c" (n) : "a" (c)
+		     : "cc", "memory");
+}
+
+static inline void
+rep_movsb(void *d, const void *s, size_t n)
+{
+	asm volatile("cld; rep movsb" : "+D" (d), "+S" (s), "+c" (n)
+		     : : "cc", "memory");
+}
+
+static inline void
+rep_movsl(void *d, const void *s, size_t n)
+{
+	asm volatile("cld; rep movsl" : "+D" (d), "+S" (s), "+c" (n)
+		     : : "cc", "memory");
+}
+
+// Below this many bytes, peeling off an unaligned head and tail costs
+// more than it saves, and plain rep movsb/stosb does.
+#define MEM_BULK	16
+
+#ifdef JOS_KERNEL
+#include <kern/fpu.h>
+
+// Large operations go to SSE2, in kernel FPU sections (kern/fpu.h),
+// from these sizes up.  Until fpu_init finds SSE2 nothing is large
+// enough; these live in .data, so memset can clear the BSS before then.
+size_t sse2_copy_min = (size_t) -1;
+size_t sse2_set_min = (size_t) -1;
+size_t sse2_cmp_min = (size_t) -1;
+
+// Whatever the thresholds say, the SSE2 loops want at least this many
+// bytes: a 64-byte block after the destination is 16-byte aligned.
+#define SSE2_BULK	128
+
+// Set n >= SSE2_BULK bytes at p to c.
+static void
+sse2_memset(char *p, int c, size_t n)
+{
+	struct Kfpu kf;
+	size_t head;
+
+	head = -(uintptr_t) p & 15;
+	rep_stosb(p, c, head);
+	p += head;
+	n -= head;
+	kfpu_begin(&kf);
+	asm volatile("movd %2, %%xmm0\n\t"
+		     "pshufd $0, %%xmm0, %%xmm0\n"
+		     "1:\tmovdqa %%xmm0, (%0)\n\t"
+		     "movdqa %%xmm0, 16(%0)\n\t"
+		     "movdqa %%xmm0, 32(%0)\n\t"
+		     "movdqa %%xmm0, 48(%0)\n\t"
+		     "addl $64, %0\n\t"
+		     "subl $64, %1\n\t"
+		     "cmpl $64, %1\n\t"
+		     "jae 1b"
+		     : "+r" (p), "+r" (n) : "r" (c * 0x01010101)
+		     : "cc", "memory");
+	kfpu_end(&kf);
+	rep_stosb(p, c, n);
+}
+
+// Copy n >= SSE2_BULK bytes forwards from s to d.  Each 64-byte block
+// is loaded whole before it is stored, so d may overlap s from below.
+static void
+sse2_memcpy(char *d, const char *s, size_t n)
+{
+	struct Kfpu kf;
+	size_t head;
+
+	head = -(uintptr_t) d & 15;
+	rep_movsb(d, s, head);
+	s += head;
+	d += head;
+	n -= head;
+	kfpu_begin(&kf);
+	asm volatile("1:\tmovdqu (%1), %%xmm0\n\t"
+		     "movdqu 16(%1), %%xmm1\n\t"
+		     "movdqu 32(%1), %%xmm2\n\t"
+		     "movdqu 48(%1), %%xmm3\n\t"
+		     "movdqa %%xmm0, (%0)\n\t"
+		     "movdqa %%xmm1, 16(%0)\n\t"
+		     "movdqa %%xmm2, 32(%0)\n\t"
+		     "movdqa %%xmm3, 48(%0)\n\t"
+		     "addl $64, %1\n\t"
+		     "addl $64, %0\n\t"
+		     "subl $64, %2\n\t"
+		     "cmpl $64, %2\n\t"
+		     "jae 1b"
+		     : "+r" (d), "+r" (s), "+r" (n) : : "cc", "memory");
+	kfpu_end(&kf);
+	rep_movsb(d, s, n);
+}
+#endif
+
+// Does the CPU have Enhanced REP MOVSB/STOSB (CPUID leaf 7, EBX bit
+// 9)?  Then rep movsb and rep stosb are as fast as the dword forms at
+// any alignment, and better at large sizes.  Asked once and cached.
+static bool
+erms(void)
+{
+	static int has_erms = -1;
+	uint32_t eax, ebx, ecx, edx;
+
+	if (has_erms < 0) {
+		asm volatile("cpuid" : "=a" (eax), "=b" (ebx), "=c" (ecx), "=d" (edx)
+			     : "a" (0));
+		ebx = 0;
+		if (eax >= 7)	// leaf 7 has subleaves; we want 0
+			asm volatile("cpuid" : "=a" (eax), "=b" (ebx), "=c" (ecx), "=d" (edx)
+				     : "a" (7), "c" (0));
+		has_erms = (ebx >> 9) & 1;
+	}
+	return has_erms;
+}
+
 void *
 memset(void *v, int c, size_t n)
 {
-	char *p;
+	char *p = v;
+	size_t head;
 
-	if (n == 0)
+	c &= 0xFF;
+#ifdef JOS_KERNEL
+	if (n >= sse2_set_min && n >= SSE2_BULK) {
+		sse2_memset(p, c, n);
 		return v;
-	if ((int)v%4 == 0 && n%4 == 0) {
-		c &= 0xFF;
-		c = (c<<24)|(c<<16)|(c<<8)|c;
-		asm volatile("cld; rep stosl\n"
-			:: "D" (v), "a" (c), "c" (n/4)
-			: "cc", "memory");
-	} else
-		asm volatile("cld; rep stosb\n"
-			:: "D" (v), "a" (c), "c" (n)
-			: "cc", "memory");
+	}
+#endif
+	if (n < MEM_BULK || erms()) {
+		rep_stosb(p, c, n);
+		return v;
+	}
+
+	// bytes up to a 4-byte boundary, dwords, then the last 0-3 bytes
+	head = -(uintptr_t) p & 3;
+	rep_stosb(p, c, head);
+	p += head;
+	n -= head;
+	rep_stosl(p, c * 0x01010101, n / 4);
+	rep_stosb(p + (n & ~3), c, n & 3);
 	return v;
 }
 
@@ -143,27 +284,57 @@ memmove(void *dst, const void *src, size_t n)
 {
 	const char *s;
 	char *d;
+	size_t head;
 
 	s = src;
 	d = dst;
 	if (s < d && s + n > d) {
-		s += n;
-		d += n;
-		if ((int)s%4 == 0 && (int)d%4 == 0 && n%4 == 0)
-			asm volatile("std; rep movsl\n"
-				:: "D" (d-4), "S" (s-4), "c" (n/4) : "cc", "memory");
-		else
-			asm volatile("std; rep movsb\n"
-				:: "D" (d-1), "S" (s-1), "c" (n) : "cc", "memory");
-		// Some versions of GCC rely on DF being clear
-		asm volatile("cld" ::: "cc");
-	} else {
-		if ((int)s%4 == 0 && (int)d%4 == 0 && n%4 == 0)
-			asm volatile("cld; rep movsl\n"
-				:: "D" (d), "S" (s), "c" (n/4) : "cc", "memory");
-		else
-			asm volatile("cld; rep movsb\n"
-				:: "D" (d), "S" (s), "c" (n) : "cc", "memory");
+		// Copy backwards, from the last bytes of s and d down.
+		// Fast strings don't help here, so always align.  DF is
+		// set only within one asm statement, so no other code
+		// (an interrupt handler's memcpy, say) ever sees it set.
+		s += n - 1;
+		d += n - 1;
+		if (n < MEM_BULK)
+			asm volatile("std; rep movsb; cld"
+				     : "+D" (d), "+S" (s), "+c" (n)
+				     : : "cc", "memory");
+		else {
+			// The bytes down to a 4-byte boundary in d, dwords,
+			// then the last 0-3 bytes; %edi and %esi move by 3
+			// between byte and dword addressing.
+			head = (uintptr_t) (d + 1) & 3;
+			n -= head;
+			asm volatile("std\n\t"
+				     "rep movsb\n\t"
+				     "subl $3, %%edi\n\t"
+				     "subl $3, %%esi\n\t"
+				     "movl %3, %%ecx\n\t"
+				     "rep movsl\n\t"
+				     "addl $3, %%edi\n\t"
+				     "addl $3, %%esi\n\t"
+				     "movl %4, %%ecx\n\t"
+				     "rep movsb\n\t"
+				     "cld"
+				     : "+D" (d), "+S" (s), "+c" (head)
+				     : "r" (n / 4), "r" (n & 3) : "cc", "memory");
+		}
+	}
+#ifdef JOS_KERNEL
+	else if (n >= sse2_copy_min && n >= SSE2_BULK)
+		sse2_memcpy(d, s, n);
+#endif
+	else if (n < MEM_BULK || erms())
+		rep_movsb(d, s, n);
+	else {
+		// Going forwards, an overlap with d below s is harmless
+		head = -(uintptr_t) d & 3;
+		rep_movsb(d, s, head);
+		s += head;
+		d += head;
+		n -= head;
+		rep_movsl(d, s, n / 4);
+		rep_movsb(d + (n & ~3), s + (n & ~3), n & 3);
 	}
 	return dst;
 }
@@ -216,6 +387,27 @@ memcmp(const void *v1, const void *v2, size_t n)
 {
 	const uint8_t *s1 = (const uint8_t *) v1;
 	const uint8_t *s2 = (const uint8_t *) v2;
+#if defined(JOS_KERNEL) && ASM
+	struct Kfpu kf;
+	uint32_t mask;
+
+	// Skip the 16-byte blocks that match; the bytes below find
+	// where the first mismatching one differs.
+	if (n >= sse2_cmp_min && n >= 16) {
+		kfpu_begin(&kf);
+		do {
+			asm volatile("movdqu (%1), %%xmm0\n\t"
+				     "movdqu (%2), %%xmm1\n\t"
+				     "pcmpeqb %%xmm1, %%xmm0\n\t"
+				     "pmovmskb %%xmm0, %0"
+				     : "=r" (mask) : "r" (s1), "r" (s2) : "memory");
+			if (mask != 0xFFFF)
+				break;
+			s1 += 16, s2 += 16, n -= 16;
+		} while (n >= 16);
+		kfpu_end(&kf);
+	}
+#endif
 
 	while (n-- > 0) {
 		if (*s1 != *s2)